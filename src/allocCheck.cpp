@@ -0,0 +1,99 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "allocCheck.h"
+
+#ifdef PACVIM_ALLOC_CHECK
+
+#include "terminal.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static thread_local long allocations = 0;
+
+void * operator new(std::size_t size) {
+  ++allocations;
+  void * p = std::malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void * operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  ++allocations;
+  return std::malloc(size ? size : 1);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void * p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void * p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept {
+  std::free(p);
+}
+
+long allocationCount() {
+  return allocations;
+}
+
+void addAllocations(long count) {
+  allocations += count;
+}
+
+AllocCheck::AllocCheck(const char * w) : what(w), start(allocations) {}
+
+AllocCheck::~AllocCheck() {
+  long made = allocations - start;
+  if (made == 0) {
+    return;
+  }
+  // on stderr, where whoever runs the check sees it, once curses lets go
+  if (stdscr) {
+    endwin();
+  }
+  std::fprintf(stderr, "ALLOC_CHECK: %ld heap allocation(s) in %s\n", made, what);
+  std::_Exit(3);
+}
+
+AllocExempt::AllocExempt() : start(allocations) {}
+
+AllocExempt::~AllocExempt() {
+  allocations = start;
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef ALLOCCHECK_H
+#define ALLOCCHECK_H
+
+// make ALLOC_CHECK=1 builds count every heap allocation, per thread. Once a
+// level has started, a game tick must not allocate: every tick (playGame's
+// frame, a --tournament or --bot-fd tick) is an AllocCheck scope, and an
+// allocation inside one stops the game with an error saying where. What
+// ThreadPool workers allocate in a parallel_for counts as the caller's, so
+// ghost planning is checked too. make alloc-check runs
+// pacvim --tournament maps/*.txt with such a build.
+// What is allowed to allocate inside a tick (writing errors.log, loading
+// a level, streaming to spectators) is wrapped in an AllocExempt.
+// In normal builds neither does anything.
+
+class AllocCheck {
+#ifdef PACVIM_ALLOC_CHECK
+  const char * what;
+  long start;
+
+public:
+  // what must be a string literal (or live as long)
+  explicit AllocCheck(const char * w);
+  ~AllocCheck();
+#else
+public:
+  explicit AllocCheck(const char *) {}
+#endif
+};
+
+// allocations in its scope don't count against the enclosing AllocCheck
+class AllocExempt {
+#ifdef PACVIM_ALLOC_CHECK
+  long start;
+
+public:
+  AllocExempt();
+  ~AllocExempt();
+#else
+public:
+  AllocExempt() {} // user-provided, so the locals don't count as unused
+#endif
+};
+
+// the allocations made on this thread so far, and a way to add those made
+// on its behalf by other threads
+#ifdef PACVIM_ALLOC_CHECK
+long allocationCount();
+void addAllocations(long count);
+#else
+inline long allocationCount() { return 0; }
+inline void addAllocations(long) {}
+#endif
+
+#endif
@@ -0,0 +1,548 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifdef PACVIM_ANSI
+
+#include "ansiTerminal.h"
+#include "unicode.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+struct WINDOW {};
+
+namespace {
+
+const chtype BLANK = ' ';
+const chtype ATTRIBUTES = A_COLOR | A_ALTCHARSET;
+// the cell right of a wide character, which the character covers; the
+// highest code A_CHARTEXT holds, which isn't Unicode
+const chtype RIGHT_HALF = A_CHARTEXT;
+
+bool rightHalf(chtype c) {
+  return (c & A_CHARTEXT) == RIGHT_HALF;
+}
+
+struct Terminal {
+  bool started = false;
+  termios saved_termios;
+  int rows = 24;
+  int cols = 80;
+  // what the game drew, and what the terminal shows right now
+  std::vector<chtype> wanted;
+  std::vector<chtype> shown;
+  bool redraw_all = true;
+  bool changed = true; // any cell drawn since the last refresh
+  int cursor_y = 0, cursor_x = 0; // where the game's cursor is
+  // where the terminal's cursor is, -1 when we don't know (after a write
+  // into the last column, terminals differ in where they leave it)
+  int at_y = -1, at_x = -1;
+  chtype attributes = 0; // colour pair and charset the terminal is set to
+  bool colors = false;
+  short pair_fg[256];
+  short pair_bg[256];
+  std::string out; // kept to avoid reallocating every frame
+
+  bool no_delay = false;
+  bool keypad_on = false;
+  int escape_delay_ms = 1000;
+  unsigned char input[64];
+  int input_begin = 0, input_end = 0;
+
+  chtype & cell(int y, int x) {
+    changed = true;
+    return wanted[y * cols + x];
+  }
+  // put c in a cell; as on a terminal, drawing over either half of a wide
+  // character takes all of it away
+  void draw(int y, int x, chtype c) {
+    if (x > 0 && rightHalf(wanted[y * cols + x])) {
+      cell(y, x - 1) = BLANK;
+    }
+    if (x + 1 < cols && rightHalf(wanted[y * cols + x + 1])) {
+      cell(y, x + 1) = BLANK;
+    }
+    cell(y, x) = c;
+  }
+  bool inside(int y, int x) const { return y >= 0 && x >= 0 && y < rows && x < cols; }
+};
+
+Terminal term;
+WINDOW the_screen;
+
+void writeAll(const std::string & s) {
+  size_t done = 0;
+  while (done < s.size()) {
+    ssize_t n = write(STDOUT_FILENO, s.data() + done, s.size() - done);
+    if (n <= 0) {
+      return;
+    }
+    done += n;
+  }
+}
+
+void appendNumber(std::string & s, int n) {
+  char digits[12];
+  snprintf(digits, sizeof(digits), "%d", n);
+  s += digits;
+}
+
+// the cells from x to to_x on row y already show what they should, in the
+// current attributes, so printing them again moves the cursor just as well
+bool canReprint(int y, int x, int to_x) {
+  for (; x < to_x; ++x) {
+    chtype c = term.shown[y * term.cols + x];
+    if (c != term.wanted[y * term.cols + x] || (c & ATTRIBUTES) != term.attributes
+        || (c & A_CHARTEXT) >= 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// append the shortest way of getting the terminal's cursor to y, x
+void moveCursor(int y, int x) {
+  if (term.at_y == y && term.at_x == x) {
+    return;
+  }
+  std::string best = "\x1b[";
+  appendNumber(best, y + 1);
+  best += ";";
+  appendNumber(best, x + 1);
+  best += "H";
+  std::string candidate;
+  auto consider = [&]() {
+    if (candidate.size() < best.size()) {
+      best.swap(candidate);
+    }
+  };
+  if (term.at_y == y && term.at_x >= 0) {
+    int distance = x - term.at_x;
+    if (distance > 0) {
+      candidate = "\x1b[";
+      if (distance > 1) {
+        appendNumber(candidate, distance);
+      }
+      candidate += "C";
+      consider();
+      if (distance < static_cast<int>(best.size()) && canReprint(y, term.at_x, x)) {
+        candidate.clear();
+        for (int i = term.at_x; i < x; ++i) {
+          candidate += static_cast<char>(term.shown[y * term.cols + i] & A_CHARTEXT);
+        }
+        consider();
+      }
+    } else {
+      candidate.assign(-distance, '\b');
+      consider();
+      candidate = "\x1b[";
+      appendNumber(candidate, -distance);
+      candidate += "D";
+      consider();
+    }
+  }
+  if (term.at_y >= 0 && term.at_y < y && x == 0) {
+    candidate.clear();
+    candidate += "\r";
+    for (int i = term.at_y; i < y; ++i) {
+      candidate += "\n";
+    }
+    consider();
+  }
+  if (term.at_y >= 0 && term.at_x == x && term.at_y != y) {
+    candidate = "\x1b[";
+    int distance = y > term.at_y ? y - term.at_y : term.at_y - y;
+    if (distance > 1) {
+      appendNumber(candidate, distance);
+    }
+    candidate += y > term.at_y ? "B" : "A";
+    consider();
+  }
+  term.out += best;
+  term.at_y = y;
+  term.at_x = x;
+}
+
+// append what it takes to switch to the colour pair and charset of c
+void setAttributes(chtype c) {
+  chtype wanted = c & ATTRIBUTES;
+  if ((wanted & A_ALTCHARSET) != (term.attributes & A_ALTCHARSET)) {
+    term.out += (wanted & A_ALTCHARSET) ? "\x1b(0" : "\x1b(B";
+  }
+  int pair = PAIR_NUMBER(wanted);
+  if (pair != PAIR_NUMBER(term.attributes)) {
+    if (pair == 0 || !term.colors) {
+      term.out += "\x1b[39;49m";
+    } else {
+      term.out += "\x1b[3";
+      appendNumber(term.out, term.pair_fg[pair]);
+      term.out += ";4";
+      appendNumber(term.out, term.pair_bg[pair]);
+      term.out += "m";
+    }
+  }
+  term.attributes = wanted;
+}
+
+void put(chtype c) {
+  if ((c & A_CHARTEXT) == '\n') {
+    clrtoeol();
+    term.cursor_y++;
+    term.cursor_x = 0;
+    return;
+  }
+  if (term.inside(term.cursor_y, term.cursor_x)) {
+    term.draw(term.cursor_y, term.cursor_x, c);
+  }
+  if (++term.cursor_x >= term.cols) {
+    term.cursor_x = 0;
+    term.cursor_y++;
+  }
+}
+
+void putString(const char * fmt, va_list args) {
+  char buffer[1024];
+  vsnprintf(buffer, sizeof(buffer), fmt, args);
+  for (const char * c = buffer; *c; ++c) {
+    put(static_cast<unsigned char>(*c));
+  }
+}
+
+// wait up to timeout_ms (forever if negative) for input; false if none came
+bool fillInput(int timeout_ms) {
+  if (term.input_begin < term.input_end) {
+    return true;
+  }
+  pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+  if (poll(&fd, 1, timeout_ms) <= 0) {
+    return false;
+  }
+  ssize_t n = read(STDIN_FILENO, term.input, sizeof(term.input));
+  if (n <= 0) {
+    return false;
+  }
+  term.input_begin = 0;
+  term.input_end = n;
+  return true;
+}
+
+int nextByte(int timeout_ms) {
+  if (!fillInput(timeout_ms)) {
+    return ERR;
+  }
+  return term.input[term.input_begin++];
+}
+
+// the rest of an escape sequence, after the escape; ERR if unknown
+int readEscapeSequence() {
+  int c = nextByte(term.escape_delay_ms);
+  if (c == ERR) {
+    return 27; // just the escape key
+  }
+  if (c == 'O') {
+    c = nextByte(term.escape_delay_ms);
+    switch (c) {
+      case 'P': return KEY_F(1);
+      case 'Q': return KEY_F(2);
+      case 'R': return KEY_F(3);
+      case 'S': return KEY_F(4);
+      case 'A': return KEY_UP;
+      case 'B': return KEY_DOWN;
+      case 'C': return KEY_RIGHT;
+      case 'D': return KEY_LEFT;
+      default: return ERR;
+    }
+  }
+  if (c != '[') {
+    return ERR;
+  }
+  int number = 0;
+  for (c = nextByte(term.escape_delay_ms); c >= '0' && c <= ';'; c = nextByte(term.escape_delay_ms)) {
+    number = c == ';' ? 0 : number * 10 + (c - '0');
+  }
+  switch (c) {
+    case 'A': return KEY_UP;
+    case 'B': return KEY_DOWN;
+    case 'C': return KEY_RIGHT;
+    case 'D': return KEY_LEFT;
+    case '~':
+      if (number >= 11 && number <= 15) {
+        return KEY_F(number - 10);
+      }
+      if (number >= 17 && number <= 21) {
+        return KEY_F(number - 11);
+      }
+      if (number == 23 || number == 24) {
+        return KEY_F(number - 12);
+      }
+      return ERR;
+    default:
+      return ERR;
+  }
+}
+
+} // namespace
+
+WINDOW * stdscr = nullptr;
+
+WINDOW * initscr() {
+  winsize size;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+    term.rows = size.ws_row;
+    term.cols = size.ws_col;
+  }
+  term.wanted.assign(term.rows * term.cols, BLANK);
+  term.shown.assign(term.rows * term.cols, BLANK);
+  if (tcgetattr(STDIN_FILENO, &term.saved_termios) == 0) {
+    termios raw = term.saved_termios;
+    raw.c_lflag &= ~ICANON;
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+  }
+  term.started = true;
+  writeAll("\x1b[?1049h");
+  clear();
+  stdscr = &the_screen;
+  return stdscr;
+}
+
+int endwin() {
+  if (!term.started) {
+    return ERR;
+  }
+  refresh();
+  writeAll("\x1b[0m\x1b(B\x1b[?1049l");
+  tcsetattr(STDIN_FILENO, TCSANOW, &term.saved_termios);
+  term.started = false;
+  return OK;
+}
+
+int nodelay(WINDOW *, bool on) {
+  term.no_delay = on;
+  return OK;
+}
+
+int keypad(WINDOW *, bool on) {
+  term.keypad_on = on;
+  return OK;
+}
+
+int set_escdelay(int ms) {
+  term.escape_delay_ms = ms;
+  return OK;
+}
+
+int noecho() {
+  termios t;
+  if (tcgetattr(STDIN_FILENO, &t) != 0) {
+    return ERR;
+  }
+  t.c_lflag &= ~ECHO;
+  return tcsetattr(STDIN_FILENO, TCSANOW, &t) == 0 ? OK : ERR;
+}
+
+int start_color() {
+  term.colors = true;
+  for (int p = 0; p < 256; ++p) {
+    term.pair_fg[p] = COLOR_WHITE;
+    term.pair_bg[p] = COLOR_BLACK;
+  }
+  return OK;
+}
+
+int init_pair(short pair, short fg, short bg) {
+  if (pair < 1 || pair > 255) {
+    return ERR;
+  }
+  term.pair_fg[pair] = fg;
+  term.pair_bg[pair] = bg;
+  return OK;
+}
+
+int getch() {
+  if (term.started && term.changed) {
+    refresh(); // as curses does; a moved cursor alone waits for the next refresh
+  }
+  int c = nextByte(term.no_delay ? 0 : -1);
+  if (c == 27 && term.keypad_on) {
+    return readEscapeSequence();
+  }
+  return c;
+}
+
+int move(int y, int x) {
+  if (!term.inside(y, x)) {
+    return ERR;
+  }
+  term.cursor_y = y;
+  term.cursor_x = x;
+  return OK;
+}
+
+int getcury(WINDOW *) {
+  return term.cursor_y;
+}
+
+int getcurx(WINDOW *) {
+  return term.cursor_x;
+}
+
+int mvaddch(int y, int x, chtype ch) {
+  if (move(y, x) == ERR) {
+    return ERR;
+  }
+  put(ch);
+  return OK;
+}
+
+int setcchar(cchar_t * wch, const wchar_t * text, attr_t attrs, short pair, const void *) {
+  wch->attr = (attrs & ~A_COLOR) | COLOR_PAIR(pair);
+  size_t i = 0;
+  for (; i + 1 < sizeof(wch->chars) / sizeof(wch->chars[0]) && text[i]; ++i) {
+    wch->chars[i] = text[i];
+  }
+  wch->chars[i] = L'\0';
+  return OK;
+}
+
+int mvadd_wch(int y, int x, const cchar_t * wch) {
+  if (move(y, x) == ERR) {
+    return ERR;
+  }
+  char32_t c = wch->chars[0];
+  if (displayWidth(c) < 2) {
+    put(c | (wch->attr & ATTRIBUTES));
+    return OK;
+  }
+  if (x + 1 >= term.cols) {
+    return ERR; // no room for the right half
+  }
+  chtype attributes = wch->attr & ATTRIBUTES;
+  term.draw(y, x, c | attributes);
+  if (x + 2 < term.cols && rightHalf(term.wanted[y * term.cols + x + 2])) {
+    term.cell(y, x + 2) = BLANK; // x + 1 was the left half of that one
+  }
+  term.cell(y, x + 1) = RIGHT_HALF | attributes;
+  term.cursor_x = x + 2;
+  return OK;
+}
+
+int printw(const char * fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  putString(fmt, args);
+  va_end(args);
+  return OK;
+}
+
+int mvprintw(int y, int x, const char * fmt, ...) {
+  if (move(y, x) == ERR) {
+    return ERR;
+  }
+  va_list args;
+  va_start(args, fmt);
+  putString(fmt, args);
+  va_end(args);
+  return OK;
+}
+
+chtype mvinch(int y, int x) {
+  if (move(y, x) == ERR) {
+    return ERR;
+  }
+  return term.wanted[y * term.cols + x];
+}
+
+int clrtoeol() {
+  if (!term.inside(term.cursor_y, term.cursor_x)) {
+    return ERR;
+  }
+  term.draw(term.cursor_y, term.cursor_x, BLANK);
+  for (int x = term.cursor_x + 1; x < term.cols; ++x) {
+    term.cell(term.cursor_y, x) = BLANK;
+  }
+  return OK;
+}
+
+int clear() {
+  term.wanted.assign(term.rows * term.cols, BLANK);
+  term.cursor_y = term.cursor_x = 0;
+  term.redraw_all = true;
+  term.changed = true;
+  return OK;
+}
+
+int refresh() {
+  std::string & out = term.out;
+  out.clear();
+  term.changed = false;
+  if (term.redraw_all) {
+    out += "\x1b[0m\x1b(B\x1b[H\x1b[2J";
+    term.shown.assign(term.rows * term.cols, BLANK);
+    term.attributes = 0;
+    term.at_y = term.at_x = 0;
+    term.redraw_all = false;
+  }
+  for (int y = 0; y < term.rows; ++y) {
+    for (int x = 0; x < term.cols; ++x) {
+      int i = y * term.cols + x;
+      if (term.wanted[i] == term.shown[i]) {
+        continue;
+      }
+      if (rightHalf(term.wanted[i])) {
+        term.shown[i] = term.wanted[i]; // written with the left half
+        continue;
+      }
+      moveCursor(y, x);
+      setAttributes(term.wanted[i]);
+      chtype c = term.wanted[i] & A_CHARTEXT;
+      if (c < 0x80) {
+        out += static_cast<char>(c);
+      } else {
+        appendUtf8(out, c);
+      }
+      term.shown[i] = term.wanted[i];
+      term.at_x++;
+      if (x + 1 < term.cols && rightHalf(term.wanted[i + 1])) {
+        term.shown[i + 1] = term.wanted[i + 1];
+        term.at_x++;
+      }
+      if (term.at_x >= term.cols) {
+        term.at_y = term.at_x = -1;
+      }
+    }
+  }
+  if (term.inside(term.cursor_y, term.cursor_x)) {
+    moveCursor(term.cursor_y, term.cursor_x);
+  }
+  if (!out.empty()) {
+    writeAll(out);
+  }
+  return OK;
+}
+
+#endif
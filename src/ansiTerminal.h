@@ -0,0 +1,112 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef ANSITERMINAL_H
+#define ANSITERMINAL_H
+
+// The part of the curses API pacvim uses, implemented straight on top of
+// ANSI escape sequences. Drawing goes into a cell buffer; refresh compares
+// it with what the terminal shows and sends only the changed cells, with
+// the shortest cursor motion and only the colour changes needed, in a
+// single write(). Walls use the DEC line drawing set, as curses' ACS
+// characters do on xterm compatible terminals. Anything outside ASCII is
+// written as UTF-8; a wide character fills its cell and the one after it.
+
+typedef unsigned int chtype;
+typedef chtype attr_t;
+struct WINDOW;
+extern WINDOW * stdscr;
+
+#define OK 0
+#define ERR (-1)
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+// a cell: the code point, then the colour pair, then the charset
+#define A_NORMAL 0U
+#define A_CHARTEXT 0x001fffffU
+#define A_COLOR 0x1fe00000U
+#define A_ALTCHARSET 0x20000000U
+#define COLOR_PAIR(n) ((chtype(n) << 21) & A_COLOR)
+#define PAIR_NUMBER(a) (int(((a) & A_COLOR) >> 21))
+
+struct cchar_t {
+  attr_t attr;
+  wchar_t chars[5];
+};
+
+#define COLOR_BLACK 0
+#define COLOR_RED 1
+#define COLOR_GREEN 2
+#define COLOR_YELLOW 3
+#define COLOR_BLUE 4
+#define COLOR_MAGENTA 5
+#define COLOR_CYAN 6
+#define COLOR_WHITE 7
+
+// DEC special graphics characters
+#define ACS_ULCORNER ('l' | A_ALTCHARSET)
+#define ACS_LLCORNER ('m' | A_ALTCHARSET)
+#define ACS_URCORNER ('k' | A_ALTCHARSET)
+#define ACS_LRCORNER ('j' | A_ALTCHARSET)
+#define ACS_LTEE ('t' | A_ALTCHARSET)
+#define ACS_RTEE ('u' | A_ALTCHARSET)
+#define ACS_BTEE ('v' | A_ALTCHARSET)
+#define ACS_TTEE ('w' | A_ALTCHARSET)
+#define ACS_HLINE ('q' | A_ALTCHARSET)
+#define ACS_VLINE ('x' | A_ALTCHARSET)
+#define ACS_PLUS ('n' | A_ALTCHARSET)
+
+// key codes, as in curses
+#define KEY_MIN 0401
+#define KEY_DOWN 0402
+#define KEY_UP 0403
+#define KEY_LEFT 0404
+#define KEY_RIGHT 0405
+#define KEY_F0 0410
+#define KEY_F(n) (KEY_F0 + (n))
+
+WINDOW * initscr();
+int endwin();
+int nodelay(WINDOW * win, bool on);
+int keypad(WINDOW * win, bool on);
+int set_escdelay(int ms);
+int noecho();
+int start_color();
+int init_pair(short pair, short fg, short bg);
+
+int getch();
+
+int move(int y, int x);
+int getcury(WINDOW * win);
+int getcurx(WINDOW * win);
+#define getyx(win, y, x) ((y) = getcury(win), (x) = getcurx(win))
+int mvaddch(int y, int x, chtype ch);
+int setcchar(cchar_t * wch, const wchar_t * text, attr_t attrs, short pair, const void * opts);
+int mvadd_wch(int y, int x, const cchar_t * wch);
+int printw(const char * fmt, ...);
+int mvprintw(int y, int x, const char * fmt, ...);
+chtype mvinch(int y, int x);
+int clrtoeol();
+int clear();
+int refresh();
+
+#endif
@@ -0,0 +1,63 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+// blocks double up to this, so a level takes a handful of them
+static const size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+Arena::Arena(size_t first_block_size) : next_block_size(first_block_size) {}
+
+Arena::~Arena() {
+  while (blocks) {
+    Block * next = blocks->next;
+    ::operator delete(blocks);
+    blocks = next;
+  }
+}
+
+void * Arena::allocate(size_t bytes, size_t alignment) {
+  uintptr_t start = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+  if (!cursor || start + bytes > reinterpret_cast<uintptr_t>(limit)) {
+    size_t size = std::max(next_block_size, bytes + alignment);
+    next_block_size = std::min(next_block_size * 2, MAX_BLOCK_SIZE);
+    Block * block = static_cast<Block *>(::operator new(sizeof(Block) + size));
+    block->next = blocks;
+    block->size = size;
+    blocks = block;
+    cursor = reinterpret_cast<char *>(block + 1);
+    limit = cursor + size;
+    start = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+  }
+  cursor = reinterpret_cast<char *>(start + bytes);
+  used += bytes;
+  return reinterpret_cast<void *>(start);
+}
+
+size_t Arena::bytesReserved() const {
+  size_t total = 0;
+  for (Block * block = blocks; block; block = block->next) {
+    total += block->size;
+  }
+  return total;
+}
@@ -0,0 +1,106 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+// Memory for everything that lives exactly as long as a level (see
+// level.h). An Arena hands out memory by bumping a pointer through a few
+// large blocks; nothing in it is freed on its own, and the blocks all go
+// at once with the arena. The containers of a level take an
+// ArenaAllocator, which keeps the arena alive for as long as any of them
+// still uses it, so moving or replacing a level frees the old one in one
+// go once its last container is gone.
+//
+// A default constructed ArenaAllocator has no arena and uses the heap, so
+// the same types work for things that aren't part of a level (--lint).
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class Arena {
+  struct Block {
+    Block * next;
+    size_t size; // of the memory after the header
+  };
+  Block * blocks = nullptr; // newest first
+  char * cursor = nullptr;
+  char * limit = nullptr;
+  size_t next_block_size;
+  size_t used = 0;
+
+public:
+  explicit Arena(size_t first_block_size = 16 * 1024);
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+
+  void * allocate(size_t bytes, size_t alignment);
+  // bytes handed out, and taken from the heap
+  size_t bytesUsed() const { return used; }
+  size_t bytesReserved() const;
+};
+
+template <class T>
+class ArenaAllocator {
+public:
+  typedef T value_type;
+  // the memory belongs to the arena, so the allocator goes where it goes
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  std::shared_ptr<Arena> arena; // none: the heap
+
+  ArenaAllocator() {}
+  explicit ArenaAllocator(std::shared_ptr<Arena> a) : arena(std::move(a)) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> & other) : arena(other.arena) {}
+
+  T * allocate(size_t n) {
+    if (arena) {
+      return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T * p, size_t) {
+    if (!arena) {
+      ::operator delete(p);
+    }
+  }
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) {
+  return a.arena == b.arena;
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) {
+  return a.arena != b.arena;
+}
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+#endif
@@ -18,30 +18,57 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
  */
 #include "avatar.h"
+#include <cassert>
+#include <cstdio>
 #include <sstream>
 
+#include "doors.h"
 #include "globals.h"
+#include "level.h"
+#include "rowScan.h"
+#include "trace.h"
+#include "unicode.h"
 
-avatar::avatar(bool human, char p, int c) {
+avatar::avatar(bool human, char p, int c, EntityId e) {
 	lives = 3;
+	points = 0;
 	isPlayer = human;
 	portrait = p;
 	color = c;
+	entity = e;
 }
 
 void avatar::spawn(int theX, int theY) {
   points = 0;
 	x = theX;
 	y = theY;
-	letterUnder = charAt(x, y);
+	board.place(entity, x, y);
 	moveTo(x, y);
 }
 
+void avatar::despawn() {
+	points = 0;
+	board.remove(entity);
+}
+
+void avatar::restore(int theX, int theY, int thePoints) {
+	points = thePoints;
+	x = theX;
+	y = theY;
+	board.place(entity, x, y);
+	move(y, x);
+}
+
+int teamPoints() {
+	return player.getPoints() + partner.getPoints();
+}
+
 int avatar::getPoints() { return points; }
 bool avatar::getPlayer() { return isPlayer; }
 int avatar::getX() { return x; }
 int avatar::getY() { return y; }
 char avatar::getPortrait() { return portrait; }
+EntityId avatar::getEntity() { return entity; }
 
 bool avatar::setPos(int theX, int theY) { 
 	x = theX;
@@ -50,85 +77,94 @@ bool avatar::setPos(int theX, int theY) {
 }
 
 bool avatar::moveTo(int a, int b, bool ignoreWalls) {
+  TRACE_SPAN("avatar::moveTo");
   if (GAME_WON == 1){
     // this prevents losing from doing repeated action like 88e
     // that first wins the game and then runs into an enemy or ~
     return false;
   }
+	if (isPlayer && board.letter(a, b) == WIDE_TAIL) {
+		a -= 1; // on the left half of a wide character, as in vim
+	}
 	if(!isValid(a, b, ignoreWalls)) {
     // movement invalid, staying still
 		return false;
 	}
 
-	// character at destination 
-	chtype curChar = charAt(a, b);
 	if(isPlayer) {
-    if (PAIR_NUMBER(curChar & A_COLOR) == 6) {
+    if (board.letter(a, b) == '~') {
 			GAME_WON = -1;
+			DEATH_CAUSE = Death::Tilde;
 		  // player hit a ~
 			return false;
 		}
-		// hit a ghost.. red color
-    if (PAIR_NUMBER(curChar & A_COLOR) == 1) {
+		// hit a ghost, also one on the right half of a wide character
+    if (board.ghostAt(a, b) || (board.letter(a + 1, b) == WIDE_TAIL && board.ghostAt(a + 1, b))) {
 			GAME_WON = -1;
+			DEATH_CAUSE = Death::Ghost;
 			// player hit a ghost!
 			return false;
 		}
+		// the other player is in the way
+		if (board.playerAt(a, b) && board.entityAt(a, b) != entity) {
+			return false;
+		}
 		
 		// points
-		if(curChar != ' ' && PAIR_NUMBER(curChar & A_COLOR) != 2) {
+		if(board.terrainAt(a, b).point && !board.isEaten(a, b)) {
 			points++;
 		}
 		// move
+		bool moved = x != a || y != b;
 		x = a;
 		y = b;
-		writeAt(x, y, curChar, COLOR_GREEN); // make it green
-		letterUnder = charAt(x, y);
+		board.place(entity, x, y);
+		board.eat(x, y); // make it green
 		move(b, a);
+		if (moved) {
+			stepOnSwitch(x, y);
+		}
 
-		if(points >= TOTAL_POINTS) {
+		if(teamPoints() >= TOTAL_POINTS) {
 			GAME_WON = 1;
 		}
 	}
 	else { // it is a ghost
 
-		// get player position, see if we stepped on the player
-		int playerX, playerY;
-		getyx(stdscr, playerY, playerX);
-		if(playerY == b && playerX == a) {
+		// see if we stepped on the player
+		if(board.playerAt(a, b)) {
 			GAME_WON = -1; // hit the player, end the game
+			DEATH_CAUSE = Death::Ghost;
 		}
 		// check if we are hitting a ghost-- if so, it's an invalid location
-    if (PAIR_NUMBER(curChar & A_COLOR) == 1) {
+    else if (board.entityAt(a, b) != NO_ENTITY && board.entityAt(a, b) != entity) {
 			return false;
 		}
-		writeAt(x, y, letterUnder);
-		letterUnder = charAt(a, b);
-
-		writeAt(a, b, portrait,  color); 
 		x = a;
 		y = b;
+		board.place(entity, x, y);
 	}
-	refresh();
 	return true;
 
 }
 bool avatar::moveRight(int repeats) {
   for (int i = 0; i < repeats; ++i) {
-	  if(!isValid(x+1, y))
+	  int next = board.nextColumn(x, y, 1);
+	  if(!isValid(next, y))
 		  return false;
 	
-	  moveTo(x+1, y+0);
+	  moveTo(next, y+0);
 	}
 	return true;
 }
 
 bool avatar::moveLeft(int repeats) {
 	for (int i = 0; i < repeats; ++i) {
-	  if(!isValid(x-1, y))
+	  int next = board.nextColumn(x, y, -1);
+	  if(!isValid(next, y))
 		  return false;
 	
-	  moveTo(x-1, y);
+	  moveTo(next, y);
 	}
 	return true;
 }
@@ -180,48 +216,50 @@ bool avatar::parseWordBackward(bool uppercase, int repeats) {
 //    move past all the spaces and start from first non-space
 // 2. If step 1 didn't move us, and
 //    uppercase == false, and
-//    the next character's alphanumericity is different,
+//    the next character's word class (see unicode.h) is different,
 //      move one character over.
 // 3. If we have moved, and stop_at_word_start == true, terminate here and return true.
 // 4. Now keep moving until either:
 //    - the next char will be a space, or
 //    - uppercase == false and
-//      the next char's alphanumericity differs from that of the current character
+//      the next char's word class differs from that of the current character
 // 5. If stop_at_word_start,
 //    - move one character over, and then
 //    - if this character is a space, move to the first non-space
 // 6. Assert that we've moved at least one space
 bool avatar::parse(bool uppercase, int offset, bool stop_at_word_start) {
   bool moved = false;
-	char curChar = charAt(x, y); 
-	char nextChar = charAt(x+offset, y);
+	char32_t curChar = letterAt(x, y); 
+	char32_t nextChar = letterAt(board.nextColumn(x, y, offset), y);
   auto move_over = [&]() {
     moved = true;
-    if (!moveTo(x+offset, y)) {
+    if (!moveTo(board.nextColumn(x, y, offset), y)) {
       return false;
     }
-	  curChar = charAt(x, y); 
-	  nextChar = charAt(x+offset, y);
+	  curChar = letterAt(x, y); 
+	  nextChar = letterAt(board.nextColumn(x, y, offset), y);
 	  return true;
 	};
+	// spaces, and the other blanks of unicode.h
+	auto blank = [](char32_t c) { return charClass(c) == CharClass::Blank; };
 	// to ensure we always return when moveTo returns false
 	#define MOVE if (!move_over()) { return false; }
 
   // 1. If this or next char is a space,
   //    move past all the spaces and start from first non-space
-	if (curChar == ' ' || nextChar == ' ') {
+	if (blank(curChar) || blank(nextChar)) {
 	  MOVE;
-	  while(curChar == ' ') {
+	  while(blank(curChar)) {
 	    MOVE;
 	  }
   }
 
-  assert(curChar != ' ' && "curChar still a space after moving past spaces");
+  assert(!blank(curChar) && "curChar still a space after moving past spaces");
 
   // 2. If step 1 didn't move us, and
   //    uppercase == false, and
-  //    the next character's alphanumericity is different,
-  if (!moved && uppercase == false && (isalnum(curChar) != isalnum(nextChar))) {
+  //    the next character's word class (see unicode.h) is different,
+  if (!moved && uppercase == false && charClass(curChar) != charClass(nextChar)) {
     //      move one character over.
     MOVE;
   }
@@ -234,12 +272,12 @@ bool avatar::parse(bool uppercase, int offset, bool stop_at_word_start) {
   // 4. Now keep moving until either:
   //    - the next char will be a space, or
   //    - uppercase == false and
-  //      the next char's alphanumericity differs from that of the current character
+  //      the next char's word class differs from that of the current character
   while(true) {
-    if (nextChar == ' ') {
+    if (blank(nextChar)) {
       break;
     }
-    if (uppercase == false && (isalnum(curChar) != isalnum(nextChar))) {
+    if (uppercase == false && charClass(curChar) != charClass(nextChar)) {
       break;
     }
     MOVE;
@@ -250,7 +288,7 @@ bool avatar::parse(bool uppercase, int offset, bool stop_at_word_start) {
     //    - move one character over, and then
     MOVE;
     //    - if this character is a space, move to the first non-space
-	  while(curChar == ' ') {
+	  while(blank(curChar)) {
 	    MOVE;
 	  }
   }
@@ -284,11 +322,12 @@ bool avatar::jumpToEnd(int repeats) {
   int specified_line = y + (repeats - 1);
   int target_line = find_reachable_line(specified_line, false);
   if (target_line == -1) {
-    writeError("Unable to find reachable line backward from ");
-    writeError(std::to_string(specified_line));
+    char message[80];
+    snprintf(message, sizeof(message), "Unable to find reachable line backward from %d", specified_line);
+    writeError(message);
     return false;
   }
-  int x = reachability_map.last_reachable_index_on_line(target_line);
+  int x = level.reachability.last_reachable_index_on_line(target_line);
   if (x != -1) {
     moveTo(x, target_line);
 	  return true;
@@ -297,7 +336,7 @@ bool avatar::jumpToEnd(int repeats) {
 }
 
 bool avatar::jumpToBeginning() { 
-  int x = reachability_map.first_reachable_index_on_line(y);
+  int x = level.reachability.first_reachable_index_on_line(y);
 	if (x != -1) {
 	  moveTo(x,y);
 	  return true;
@@ -306,87 +345,89 @@ bool avatar::jumpToBeginning() {
 }
 
 bool avatar::percentJump() {
-  int source_x = x;
-  chtype letter;
-  char opposite = 'x'; bool forward = true;
-  while (opposite == 'x' && source_x < WIDTH) {
-    if (charAt(source_x, y) > 4000000) {
-      return false; // don't allow walljump for finding opening bracket
-    }
-    letter = letterAt(source_x,y);
-    if(letter == '(') {
-	    opposite = ')';
-    }
-    else if(letter == '{') {
-	    opposite = '}';
-    }
-    else if(letter == '[') {
-	    opposite = ']';
-    }
-    else if(letter == ')') {
-	    opposite = '(';
-	    forward = false;
-    }
-    else if(letter == '}') {
-	    opposite = '{';
-	    forward = false;
-    }
-    else if(letter == ']') {
-	    opposite = '[';
-	    forward = false;
-    }
-    if (opposite == 'x') {
-      source_x += 1;
-    }
+  if (!board.inside(x, y)) {
+    return false;
   }
-  if (opposite == 'x') {
+  // don't allow walljump for finding opening bracket
+  static const ByteClass BRACKETS("({[)}]", false);
+  int source_x = scanRight(board.scanRow(y), x, WIDTH, BRACKETS, '#');
+  if (source_x == -1) {
     // no bracket char found
     return false;
   }
+  char32_t letter = letterAt(source_x,y);
+  char opposite; bool forward = true;
+  if(letter == '(') {
+    opposite = ')';
+  }
+  else if(letter == '{') {
+    opposite = '}';
+  }
+  else if(letter == '[') {
+    opposite = ']';
+  }
+  else if(letter == ')') {
+    opposite = '(';
+    forward = false;
+  }
+  else if(letter == '}') {
+    opposite = '{';
+    forward = false;
+  }
+  else {
+    opposite = '[';
+    forward = false;
+  }
   int offset = forward ? 1 : -1;
+  ByteClass wanted(opposite);
   for(int target_y = y; target_y >= 0 && target_y < HEIGHT; target_y += offset) {
     int start_x = target_y == y ? source_x + offset : (forward ? 0 : WIDTH - 1);
-    for(int target_x = start_x; target_x >= 0 && target_x < WIDTH; target_x += offset) {
-      chtype letter = letterAt(target_x,target_y);
-      if(letter == opposite){
-        return moveTo(target_x,target_y);
-      }
+    const char * row = board.scanRow(target_y);
+    int target_x = forward ? scanRight(row, start_x, WIDTH, wanted, NO_STOP)
+                           : scanLeft(row, start_x, 0, wanted, NO_STOP);
+    if(target_x != -1){
+      return moveTo(target_x,target_y);
     }
   }
   return false;
 }
 
-bool avatar::jumpToChar(char targetChar, bool forward, bool includingTarget, bool acrossWalls, int repeats) {
-  std::vector<int> target_list;
+bool avatar::jumpToChar(char32_t targetChar, bool forward, bool includingTarget, bool acrossWalls, int repeats) {
+  if (repeats < 1 || !board.inside(x, y)) {
+    return false;
+  }
   int offset = forward ? 1 : -1;
-  for(int target_x = x + offset; target_x >= 0 && target_x < WIDTH + 1; target_x += offset) {
-    if (!acrossWalls && charAt(target_x, y) > 4000000) {
+  // first find the repeats-th target, then step on every target up to it;
+  // nobody moves unless all of them are there
+  const char * row = board.scanRow(y);
+  ByteClass wanted(scanByte(targetChar));
+  int stop = acrossWalls ? NO_STOP : '#';
+  int start_x = x, last_x = start_x, found = 0;
+  while (found < repeats) {
+    last_x = forward ? scanRight(row, last_x + 1, WIDTH + 1, wanted, stop)
+                     : scanLeft(row, last_x - 1, 0, wanted, stop);
+    if (last_x == -1) {
       return false;
     }
-    chtype letter = letterAt(target_x,y);
-    if(letter == targetChar){
-      int real_target = target_x;
-      if (!includingTarget) {
-        real_target -= offset;
-      }
-      target_list.push_back(real_target);
-      --repeats;
-      if (repeats == 0) {
-        for (int tx : target_list) {
-          moveTo(tx,y);
-        }
-        return true;
-      }
+    // outside ASCII, the byte matching only makes it a candidate
+    if (letterAt(last_x,y) == targetChar) {
+      ++found;
     }
   }
-  return false;
+  for(int target_x = start_x + offset; target_x != last_x + offset; target_x += offset) {
+    if (letterAt(target_x,y) == targetChar) {
+      // t stops a character short, the whole of a wide one
+      moveTo(includingTarget ? target_x : board.nextColumn(target_x, y, -offset), y);
+    }
+  }
+  return true;
 }
 
-bool avatar::jumpForward(char targetChar, bool includingTarget, bool acrossWalls, int repeats) {
+bool avatar::jumpForward(char32_t targetChar, bool includingTarget, bool acrossWalls, int repeats) {
   return jumpToChar(targetChar, true, includingTarget, acrossWalls, repeats);
 }
 
-bool avatar::jumpBackward(char targetChar, bool includingTarget, bool acrossWalls, int repeats) {
+bool avatar::jumpBackward(char32_t targetChar, bool includingTarget, bool acrossWalls, int repeats) {
   return jumpToChar(targetChar, false, includingTarget, acrossWalls, repeats);
 }
 
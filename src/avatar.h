@@ -24,13 +24,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 #include <unistd.h>
 #include "helperFns.h"
+#include "occupancy.h"
 // Avatar Class -- can be a ghost or player
 class avatar {
 	public:
-    avatar(bool human, char p, int c);
+    avatar(bool human, char p, int c, EntityId e);
     virtual void spawn(int theX, int theY);
+    // take it off the board, and forget its points
+    void despawn();
+    // put the player back where it was, with the points it had then
+    void restore(int theX, int theY, int thePoints);
 	protected:
-		chtype letterUnder;
 		int x;
 		int y;
 		bool isPlayer;
@@ -38,6 +42,7 @@ class avatar {
 		char portrait;
 		int lives;
 		int color;
+		EntityId entity;
 	public:	
     bool moveTo(int a, int b, bool ignoreWalls = false);
 		//bool moveTo(int, int, bool);
@@ -55,9 +60,9 @@ class avatar {
 		bool jumpToBeginning();
 		bool jumpToEnd(int repeats);
 	  bool percentJump();
-		bool jumpToChar(char, bool, bool, bool, int repeats);
-		bool jumpForward(char, bool, bool, int repeats);
-		bool jumpBackward(char, bool, bool, int repeats);
+		bool jumpToChar(char32_t, bool, bool, bool, int repeats);
+		bool jumpForward(char32_t, bool, bool, int repeats);
+		bool jumpBackward(char32_t, bool, bool, int repeats);
 
 		int getPoints();
 		bool getPlayer();
@@ -65,8 +70,10 @@ class avatar {
 		int getY();
 		bool setPos(int, int);
 		char getPortrait();
-
-		void setLetterUnder(char);
+		EntityId getEntity();
 };
+
+// what both players have eaten together (the partner only plays in --host games)
+int teamPoints();
 	
 #endif
@@ -0,0 +1,228 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "terminal.h"
+
+#include "board.h"
+
+static Terrain outsideTerrain() {
+  Terrain t;
+  t.letter = '#';
+  t.wall = Wall::Plus;
+  t.color = WALL_COLOR;
+  return t;
+}
+static const Terrain OUTSIDE = outsideTerrain();
+
+void Board::reset(int w, int h) {
+  width = w;
+  height = h;
+  terrain.assign(width * height, Terrain());
+  scan_bytes.assign(width * height, ' ');
+  eaten.assign(width * height, 0);
+  newly_eaten.clear();
+  entities.reset(width, height);
+  entities.reserve(FIRST_GHOST_ENTITY);
+  dirty.assign(width * height, 0);
+  dirty_cells.clear();
+  rendered.clear();
+  // every cell fits, so that playing never allocates
+  newly_eaten.reserve(width * height);
+  dirty_cells.reserve(width * height);
+  rendered.reserve(width * height);
+  markAllDirty();
+}
+
+void Board::loadTerrain(int w, int h, const Terrain * layer) {
+  reset(w, h);
+  terrain.assign(layer, layer + width * height);
+  for (int cell = 0; cell < width * height; ++cell) {
+    scan_bytes[cell] = scanByte(terrain[cell].letter);
+  }
+}
+
+void Board::setTerrain(int x, int y, const Terrain & t) {
+  if (!inside(x, y)) {
+    return;
+  }
+  terrain[index(x, y)] = t;
+  scan_bytes[index(x, y)] = scanByte(t.letter);
+  markDirty(x, y);
+}
+
+const Terrain & Board::terrainAt(int x, int y) const {
+  return inside(x, y) ? terrain[index(x, y)] : OUTSIDE;
+}
+
+bool Board::isWall(int x, int y) const {
+  return terrainAt(x, y).wall != Wall::None;
+}
+
+char32_t Board::letter(int x, int y) const {
+  return terrainAt(x, y).letter;
+}
+
+int Board::nextColumn(int x, int y, int offset) const {
+  x += offset;
+  return letter(x, y) == WIDE_TAIL ? x + offset : x;
+}
+
+bool Board::isValid(int x, int y, bool ignoreWalls) const {
+  if (!inside(x, y)) {
+    return false;
+  }
+  return ignoreWalls || !isWall(x, y);
+}
+
+bool Board::isEaten(int x, int y) const {
+  return inside(x, y) && eaten[index(x, y)];
+}
+
+void Board::eat(int x, int y) {
+  if (!inside(x, y) || eaten[index(x, y)]) {
+    return;
+  }
+  eaten[index(x, y)] = 1;
+  newly_eaten.push_back(index(x, y));
+  markDirty(x, y);
+}
+
+void Board::takeNewlyEaten(std::vector<int> & cells) {
+  cells.clear();
+  cells.swap(newly_eaten);
+}
+
+void Board::setEatenLayer(const std::vector<unsigned char> & layer) {
+  for (int cell = 0; cell < width * height && cell < static_cast<int>(layer.size()); ++cell) {
+    if (eaten[cell] != layer[cell]) {
+      eaten[cell] = layer[cell];
+      markDirty(cell % width, cell / width);
+    }
+  }
+  newly_eaten.clear();
+}
+
+void Board::place(EntityId id, int x, int y) {
+  int old_x, old_y;
+  if (entities.position(id, old_x, old_y)) {
+    markDirty(old_x, old_y);
+  }
+  entities.place(id, x, y);
+  markDirty(x, y);
+}
+
+void Board::remove(EntityId id) {
+  int old_x, old_y;
+  if (entities.position(id, old_x, old_y)) {
+    markDirty(old_x, old_y);
+  }
+  entities.remove(id);
+}
+
+Glyph Board::compose(int x, int y) const {
+  if (ghostAt(x, y)) {
+    return { 'G', Wall::None, GHOST_COLOR };
+  }
+  const Terrain & t = terrainAt(x, y);
+  // a ghost on half of a wide character leaves the other half blank
+  if (t.letter == WIDE_TAIL) {
+    return { ghostAt(x - 1, y) ? ' ' : WIDE_TAIL, Wall::None, t.color };
+  }
+  if (letter(x + 1, y) == WIDE_TAIL && ghostAt(x + 1, y)) {
+    return { ' ', Wall::None, t.color };
+  }
+  if (entityAt(x, y) == PARTNER_ENTITY) {
+    return { t.letter, Wall::None, PARTNER_COLOR };
+  }
+  if (t.wall != Wall::None) {
+    return { t.letter, t.wall, t.color };
+  }
+  return { t.letter, Wall::None, isEaten(x, y) ? EATEN_COLOR : t.color };
+}
+
+void Board::markDirty(int x, int y) {
+  if (!inside(x, y) || dirty[index(x, y)]) {
+    return;
+  }
+  // both halves of a wide character are drawn again, the left one first
+  if (terrain[index(x, y)].letter == WIDE_TAIL) {
+    markDirty(x - 1, y);
+    if (dirty[index(x, y)]) {
+      return;
+    }
+  }
+  dirty[index(x, y)] = 1;
+  dirty_cells.push_back(index(x, y));
+  if (x + 1 < width && terrain[index(x + 1, y)].letter == WIDE_TAIL) {
+    markDirty(x + 1, y);
+  }
+}
+
+void Board::markAllDirty() {
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      markDirty(x, y);
+    }
+  }
+}
+
+static chtype wallGlyph(Wall wall) {
+  switch (wall) {
+    case Wall::HLine: return ACS_HLINE;
+    case Wall::VLine: return ACS_VLINE;
+    case Wall::ULCorner: return ACS_ULCORNER;
+    case Wall::URCorner: return ACS_URCORNER;
+    case Wall::LLCorner: return ACS_LLCORNER;
+    case Wall::LRCorner: return ACS_LRCORNER;
+    case Wall::LTee: return ACS_LTEE;
+    case Wall::RTee: return ACS_RTEE;
+    case Wall::TTee: return ACS_TTEE;
+    case Wall::BTee: return ACS_BTEE;
+    case Wall::Plus: return ACS_PLUS;
+    default: return '#';
+  }
+}
+
+void drawGlyph(int x, int y, const Glyph & g) {
+  if (g.letter == WIDE_TAIL) {
+    return;
+  }
+  if (g.wall != Wall::None || g.letter < 0x80) {
+    chtype ch = g.wall != Wall::None ? wallGlyph(g.wall) : g.letter;
+    mvaddch(y, x, ch | COLOR_PAIR(g.color));
+    return;
+  }
+  wchar_t text[] = { static_cast<wchar_t>(g.letter), L'\0' };
+  cchar_t ch;
+  setcchar(&ch, text, A_NORMAL, g.color, nullptr);
+  mvadd_wch(y, x, &ch);
+}
+
+int Board::render() {
+  int curX, curY;
+  getyx(stdscr, curY, curX);
+  for (int cell : dirty_cells) {
+    dirty[cell] = 0;
+    drawGlyph(cell % width, cell / width, compose(cell % width, cell / width));
+  }
+  rendered.swap(dirty_cells);
+  dirty_cells.clear();
+  move(curY, curX);
+  return rendered.size();
+}
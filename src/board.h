@@ -0,0 +1,143 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef BOARD_H
+#define BOARD_H
+
+// The game board, in screen coordinates (the two line number columns
+// included), kept in three layers:
+// - terrain: a copy of the level's (see level.h); only doors change it
+//   during a level
+// - eaten: which cells the player has turned green
+// - entities: who stands where (see occupancy.h)
+// and the letters once more, a byte per cell, for the row scans of
+// rowScan.h.
+// What a cell looks like is worked out from the layers only when the cell
+// is drawn, and only cells that changed since the last render are drawn.
+// A wide character is drawn from its left cell, over both of its cells
+// (see unicode.h), unless a ghost stands on either of them.
+
+#include <vector>
+#include "occupancy.h"
+#include "unicode.h"
+
+// the shape of a wall cell, which depends on its neighbouring walls
+enum class Wall : unsigned char {
+  None, HLine, VLine, ULCorner, URCorner, LLCorner, LRCorner,
+  LTee, RTee, TTee, BTee, Plus
+};
+
+// colour pairs, as set up by defineColors
+const unsigned char DEFAULT_COLOR = 0;
+const unsigned char GHOST_COLOR = 1;
+const unsigned char EATEN_COLOR = 2;
+const unsigned char WALL_COLOR = 3;
+const unsigned char DOOR_COLOR = 4; // closed doors and their switches
+const unsigned char PARTNER_COLOR = 5; // the other player, in a --host game
+const unsigned char TILDE_COLOR = 6;
+const unsigned char LINE_NUMBER_COLOR = 8;
+
+struct Terrain {
+  char32_t letter = ' '; // '#' for walls, WIDE_TAIL right of a wide character
+  Wall wall = Wall::None;
+  unsigned char color = DEFAULT_COLOR;
+  bool point = false; // counts towards TOTAL_POINTS
+};
+
+// what ends up on the screen for one cell
+struct Glyph {
+  char32_t letter; // WIDE_TAIL: nothing, the character on the left covers it
+  Wall wall;
+  unsigned char color;
+};
+
+class Board {
+  int width = 0;
+  int height = 0;
+  std::vector<Terrain> terrain;
+  std::vector<char> scan_bytes; // scanByte of every letter
+  std::vector<unsigned char> eaten;
+  std::vector<int> newly_eaten; // since the last takeNewlyEaten
+  OccupancyGrid entities;
+  std::vector<unsigned char> dirty;
+  std::vector<int> dirty_cells;
+  std::vector<int> rendered; // by the last render
+
+  int index(int x, int y) const { return y * width + x; }
+
+public:
+  // an empty board of w x h cells, all of them dirty
+  void reset(int w, int h);
+  // reset, then take over a whole terrain layer of w x h cells
+  void loadTerrain(int w, int h, const Terrain * layer);
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  bool inside(int x, int y) const {
+    return x >= 0 && y >= 0 && x < width && y < height;
+  }
+
+  // terrain; only changed while loading a level and by doors
+  void setTerrain(int x, int y, const Terrain & t);
+  const Terrain & terrainAt(int x, int y) const;
+  // outside the board counts as wall
+  bool isWall(int x, int y) const;
+  // the letter as in the map file ('#' for walls), ignoring ghosts
+  char32_t letter(int x, int y) const;
+  // line y as getWidth() bytes, scanByte of each letter (see unicode.h)
+  const char * scanRow(int y) const { return &scan_bytes[y * width]; }
+  // the column of the character offset (1 or -1) away from x; that skips
+  // the right half of a wide character
+  int nextColumn(int x, int y, int offset) const;
+  // same rules as the isValid helper
+  bool isValid(int x, int y, bool ignoreWalls = false) const;
+
+  // eaten overlay
+  bool isEaten(int x, int y) const;
+  void eat(int x, int y);
+  // for the rewind history: cells eaten since the last call (as y * width + x),
+  // and the whole layer at once
+  void takeNewlyEaten(std::vector<int> & cells);
+  const std::vector<unsigned char> & eatenLayer() const { return eaten; }
+  void setEatenLayer(const std::vector<unsigned char> & layer);
+
+  // entity layer
+  EntityId entityAt(int x, int y) const { return entities.at(x, y); }
+  bool ghostAt(int x, int y) const { return entities.ghostAt(x, y); }
+  bool playerAt(int x, int y) const { return entities.playerAt(x, y); }
+  bool position(EntityId id, int & x, int & y) const { return entities.position(id, x, y); }
+  void place(EntityId id, int x, int y);
+  void remove(EntityId id);
+  // for ids below count, place and remove don't allocate
+  void reserveEntities(EntityId count) { entities.reserve(count); }
+
+  // the layers combined
+  Glyph compose(int x, int y) const;
+  void markDirty(int x, int y);
+  void markAllDirty();
+  // draw the dirty cells to the screen, returns how many were drawn
+  int render();
+  // the cells the last render drew, as y * width + x
+  const std::vector<int> & lastRendered() const { return rendered; }
+};
+
+// put one glyph on the screen
+void drawGlyph(int x, int y, const Glyph & g);
+
+#endif
@@ -0,0 +1,355 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "bot.h"
+#include "allocCheck.h"
+#include "avatar.h"
+#include "doors.h"
+#include "game.h"
+#include "ghost1.h"
+#include "headless.h"
+#include "level.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+const int NO_POSITION = 0xFFFF;
+// the longest keys message there can be: a count (2) and 65535 keys (3 each)
+const size_t MAX_KEYS_LENGTH = 2 + 3 * 0xFFFF;
+
+struct Options {
+  int in_fd = -1;
+  int out_fd = -1;
+  int batch = 10;
+  unsigned seed = Ghosts::RANDOM_SEED;
+  double max_seconds = 600;
+  double think_multiplier = 1.0;
+};
+
+void put8(std::string & out, int v) {
+  out.push_back(static_cast<char>(v));
+}
+
+void put16(std::string & out, int v) {
+  put8(out, v & 0xFF);
+  put8(out, (v >> 8) & 0xFF);
+}
+
+void put32(std::string & out, uint32_t v) {
+  put16(out, v & 0xFFFF);
+  put16(out, v >> 16);
+}
+
+uint32_t get16(const unsigned char * in) {
+  return in[0] | in[1] << 8;
+}
+
+uint32_t get32(const unsigned char * in) {
+  return get16(in) | get16(in + 2) << 16;
+}
+
+// one message to the bot at a time: a length, then what put* added
+class Writer {
+  int fd;
+  std::string message;
+
+public:
+  explicit Writer(int out_fd) : fd(out_fd) {}
+
+  std::string & begin(char type) {
+    message.assign(4, '\0');
+    message.push_back(type);
+    return message;
+  }
+
+  // false if the bot has gone
+  bool send() {
+    uint32_t length = message.size() - 4;
+    for (int i = 0; i < 4; ++i) {
+      message[i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    }
+    size_t sent = 0;
+    while (sent < message.size()) {
+      ssize_t n = write(fd, message.data() + sent, message.size() - sent);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      sent += n;
+    }
+    return true;
+  }
+};
+
+bool readExactly(int fd, unsigned char * buffer, size_t length) {
+  size_t got = 0;
+  while (got < length) {
+    ssize_t n = read(fd, buffer + got, length - got);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    got += n;
+  }
+  return true;
+}
+
+// the keys for the next batch, keys[tick in batch]; false if the bot has gone
+bool readKeys(int fd, int batch, std::vector<std::string> & keys) {
+  unsigned char header[4];
+  if (!readExactly(fd, header, sizeof(header))) {
+    return false;
+  }
+  size_t length = get32(header);
+  if (length > MAX_KEYS_LENGTH) {
+    // the length is the bot's word; don't try to allocate gigabytes for it
+    std::cerr << "bot sent a " << length << " byte keys message, at most "
+              << MAX_KEYS_LENGTH << " is allowed" << std::endl;
+    return false;
+  }
+  std::vector<unsigned char> payload(length);
+  if (!readExactly(fd, payload.data(), payload.size()) || payload.size() < 2) {
+    return false;
+  }
+  keys.assign(batch, std::string());
+  size_t count = get16(payload.data());
+  for (size_t i = 0; i < count && 2 + 3 * (i + 1) <= payload.size(); ++i) {
+    const unsigned char * key = &payload[2 + 3 * i];
+    int tick = std::min<int>(get16(key), batch - 1);
+    keys[tick].push_back(static_cast<char>(key[2]));
+  }
+  return true;
+}
+
+void putCell(std::string & m, int x, int y) {
+  const Terrain & t = board.terrainAt(x, y);
+  put32(m, t.letter);
+  put8(m, (t.wall != Wall::None ? 1 : 0) | (t.point ? 2 : 0));
+}
+
+void writeLevel(Writer & out) {
+  std::string & m = out.begin('L');
+  put16(m, CURRENT_LEVEL);
+  put16(m, board.getWidth());
+  put16(m, board.getHeight());
+  put32(m, TOTAL_POINTS);
+  for (int y = 0; y < board.getHeight(); ++y) {
+    for (int x = 0; x < board.getWidth(); ++x) {
+      putCell(m, x, y);
+    }
+  }
+}
+
+// the game as it is after a tick, straight from the board and the ghosts;
+// doors_open is what the bot was last told about the doors
+void addObservation(std::string & m, long tick, bool out_of_time, std::vector<int> & eaten,
+                    std::vector<unsigned char> & doors_open) {
+  put32(m, tick);
+  put8(m, GAME_WON == 1 ? 1 : GAME_WON != 0 ? 2 : out_of_time ? 3 : 0);
+  put16(m, player.getX());
+  put16(m, player.getY());
+  put32(m, player.getPoints());
+  put32(m, std::max(0, TOTAL_POINTS - player.getPoints()));
+  put16(m, ghosts.size());
+  for (size_t i = 0; i < ghosts.size(); ++i) {
+    int x, y;
+    if (board.position(FIRST_GHOST_ENTITY + i, x, y)) {
+      put16(m, x);
+      put16(m, y);
+    } else {
+      put16(m, NO_POSITION);
+      put16(m, NO_POSITION);
+    }
+  }
+  board.takeNewlyEaten(eaten);
+  put16(m, eaten.size());
+  for (int cell : eaten) {
+    put16(m, cell % board.getWidth());
+    put16(m, cell / board.getWidth());
+  }
+  size_t changed_at = m.size();
+  put16(m, 0);
+  int changed = 0;
+  for (int door = 0; door < doorCount(); ++door) {
+    if (doorOpen(door) != static_cast<bool>(doors_open[door])) {
+      doors_open[door] = doorOpen(door);
+      put16(m, level.doors[door].x);
+      put16(m, level.doors[door].y);
+      putCell(m, level.doors[door].x, level.doors[door].y);
+      ++changed;
+    }
+  }
+  m[changed_at] = static_cast<char>(changed & 0xFF);
+  m[changed_at + 1] = static_cast<char>(changed >> 8);
+}
+
+enum Outcome { WON, GHOST, TILDE, OUT_OF_TIME, BOT_GONE };
+
+Outcome playLevel(const Options & options, Writer & out) {
+  writeLevel(out);
+  if (!out.send()) {
+    return BOT_GONE;
+  }
+  std::vector<int> eaten;
+  // the 'L' message has the doors closed
+  std::vector<unsigned char> doors_open(doorCount(), 0);
+  std::string * m = &out.begin('T');
+  put16(*m, 1);
+  addObservation(*m, 0, false, eaten, doors_open);
+  if (!out.send()) {
+    return BOT_GONE;
+  }
+  KeyParser parser;
+  std::vector<std::string> keys;
+  long max_ticks = std::lround(options.max_seconds / TICK_SECONDS);
+  long tick = 0;
+  while (GAME_WON == 0 && tick < max_ticks) {
+    if (!readKeys(options.in_fd, options.batch, keys)) {
+      return BOT_GONE;
+    }
+    m = &out.begin('T');
+    size_t count_at = m->size();
+    put16(*m, 0);
+    int count = 0;
+    for (int i = 0; i < options.batch && GAME_WON == 0 && tick < max_ticks; ++i, ++count) {
+      ++tick;
+      {
+        AllocCheck check("a --bot-fd tick");
+        for (char key : keys[i]) {
+          if (GAME_WON == 0) {
+            doKeystroke(player, parser.feed(key));
+          }
+        }
+        headlessTick(tick);
+      }
+      addObservation(*m, tick, tick >= max_ticks, eaten, doors_open);
+    }
+    (*m)[count_at] = static_cast<char>(count & 0xFF);
+    (*m)[count_at + 1] = static_cast<char>(count >> 8);
+    if (!out.send()) {
+      return BOT_GONE;
+    }
+  }
+  ghosts.clear();
+  if (GAME_WON == 1) {
+    return WON;
+  }
+  if (GAME_WON == 0) {
+    return OUT_OF_TIME;
+  }
+  return DEATH_CAUSE == Death::Tilde ? TILDE : GHOST;
+}
+
+bool parseFds(const std::string & text, Options & options) {
+  char comma;
+  std::stringstream in(text);
+  return (in >> options.in_fd >> comma >> options.out_fd) && comma == ',' && in.eof()
+      && options.in_fd >= 0 && options.out_fd >= 0;
+}
+
+bool parseOptions(const std::vector<std::string> & args, Options & options) {
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string & arg = args[i];
+    bool has_value = i + 1 < args.size();
+    char * end = nullptr;
+    if (arg == "--bot-fd" && has_value && parseFds(args[++i], options)) {
+    } else if (arg == "--batch" && has_value) {
+      options.batch = strtol(args[++i].c_str(), &end, 10);
+      if (*end != '\0' || options.batch < 1 || options.batch > 0xFFFF) {
+        return false;
+      }
+    } else if (arg == "--seed" && has_value) {
+      options.seed = strtoul(args[++i].c_str(), &end, 10);
+      if (*end != '\0') {
+        return false;
+      }
+    } else if (arg == "--max-seconds" && has_value) {
+      options.max_seconds = strtod(args[++i].c_str(), &end);
+      if (*end != '\0' || options.max_seconds <= 0) {
+        return false;
+      }
+    } else if (arg == "h" || arg == "n") {
+      options.think_multiplier = arg == "n" ? 1.2 : 1.0; // as in checkParams
+    } else if (!arg.empty() && arg.find_first_not_of("0123456789") == std::string::npos) {
+      CURRENT_LEVEL = atoi(arg.c_str());
+      if (CURRENT_LEVEL > NUM_OF_LEVELS) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return options.in_fd != -1;
+}
+
+} // namespace
+
+int runBot(const std::vector<std::string> & args) {
+  Options options;
+  if (!parseOptions(args, options)) {
+    std::cerr << "Usage: pacvim --bot-fd IN,OUT [--batch TICKS] [--seed N] [--max-seconds S] [LEVEL] [h/n]"
+              << std::endl;
+    return 2;
+  }
+  // a bot that quits shows up as a failed write, not a signal
+  signal(SIGPIPE, SIG_IGN);
+  Writer out(options.out_fd);
+  IN_TUTORIAL = false;
+  while (LIVES >= 0 && CURRENT_LEVEL <= NUM_OF_LEVELS) {
+    std::string map = MAPS_LOCATION "/map" + std::to_string(CURRENT_LEVEL) + ".txt";
+    if (!startHeadlessLevel(map, options.think_multiplier, options.seed)) {
+      std::cerr << "Cannot open " << map << std::endl;
+      return 1;
+    }
+    Outcome outcome = playLevel(options, out);
+    if (outcome == BOT_GONE) {
+      return 0;
+    }
+    if (outcome == WON) {
+      if (CURRENT_LEVEL % 3 == 0) {
+        LIVES++; // as in main
+      }
+      CURRENT_LEVEL++;
+    } else {
+      LIVES--;
+    }
+    std::string & m = out.begin('E');
+    put8(m, outcome);
+    put16(m, std::max(0, LIVES));
+    put8(m, LIVES < 0 || CURRENT_LEVEL > NUM_OF_LEVELS ? 1 : 0);
+    if (!out.send()) {
+      return 0;
+    }
+  }
+  close(options.out_fd);
+  return 0;
+}
@@ -0,0 +1,65 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef BOT_H
+#define BOT_H
+
+// pacvim --bot-fd IN,OUT: a bot plays the game through two pipes, without
+// a terminal and on a simulated clock (see headless.h), so bots can be
+// written in any language. The game writes observations to the file
+// descriptor OUT and reads keys from IN:
+//
+//   pacvim --bot-fd IN,OUT [--batch TICKS] [--seed N] [--max-seconds S] [LEVEL] [h/n]
+//
+// The levels are played in order from LEVEL, with the lives of the normal
+// game; the game closes OUT when it is over. Every message, both ways, is
+// a 4 byte length and then that many bytes; all numbers are unsigned
+// little-endian, coordinates are screen columns and rows like everywhere
+// else in pacvim. From the game:
+//
+//   'L' a level starts: level (2), width (2), height (2), total points (4),
+//       then width * height cells of letter (4, a Unicode code point;
+//       0x110000 for the right half of a wide character) and flags (1):
+//       1 wall, 2 counts as a point
+//   'T' observations: count (2), then per tick:
+//       tick (4), state (1: 0 playing, 1 won, 2 lost, 3 out of time), player x, y (2 each),
+//       points (4), points left (4), ghost count (2) and per ghost x, y
+//       (2 each; 65535 while an Agent Smith hides), eaten count (2) and
+//       per cell eaten in this tick x, y (2 each), changed count (2) and
+//       per cell whose terrain changed in this tick (a door that opened
+//       or closed) x, y (2 each) and the cell as in 'L'
+//   'E' the level is over: outcome (1: 0 won, 1 ghost, 2 ~, 3 out of
+//       time), lives left (2), game over (1: 1 when no level follows)
+//
+// Every level starts with an 'L' and a 'T' of the state before any key.
+// The bot answers every 'T' whose last state is still playing with the
+// keys for the next TICKS ticks (10 by default):
+//
+//   count (2), then per key its tick in the batch (2, from 0) and the key (1)
+//
+// A longer message than that can hold (2 + 3 * 65535 bytes) ends the game
+// as if the bot had gone.
+
+#include <string>
+#include <vector>
+
+// returns the exit code
+int runBot(const std::vector<std::string> & args);
+
+#endif
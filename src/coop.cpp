@@ -0,0 +1,351 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "coop.h"
+#include "board.h"
+#include "keyQueue.h"
+#include "terminal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const uint32_t MAGIC = 0x70616376; // "pacv"
+const uint32_t VERSION = 2;
+const int MAX_WIDTH = 256;
+const int MAX_HEIGHT = 128;
+const int HUD_SIZE = 256;
+const int HUD_LINES = 4; // cleared under the board when the text changes
+
+// what the board looks like, written by the host only
+struct CoopFrame {
+  int16_t width;
+  int16_t height;
+  int16_t host_x;
+  int16_t host_y;
+  int16_t partner_x; // -1 while the partner isn't on the board
+  int16_t partner_y;
+  char hud[HUD_SIZE];
+  Glyph cells[MAX_WIDTH * MAX_HEIGHT]; // y * width + x
+};
+
+std::string shmName(const std::string & name) {
+  return "/pacvim-" + name;
+}
+
+} // namespace
+
+struct CoopSegment {
+  uint32_t magic = MAGIC;
+  uint32_t version = VERSION;
+  int32_t host_pid = getpid();
+  std::atomic<uint32_t> host_playing{1};
+  std::atomic<uint32_t> partner_joined{0};
+  KeyQueue partner_keys;
+  // a seqlock around frame: odd while the host is writing it
+  std::atomic<uint32_t> sequence{0};
+  CoopFrame frame;
+};
+
+namespace {
+
+// whether the segment called shm_name belongs to a host that is still
+// running; a segment from another version can't tell, and counts as left
+// behind
+bool hostAlive(const std::string & shm_name) {
+  int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  void * memory = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(CoopSegment))) {
+    memory = mmap(nullptr, sizeof(CoopSegment), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+  const CoopSegment * segment = static_cast<const CoopSegment *>(memory);
+  bool alive = segment->magic == MAGIC && segment->version == VERSION
+      && segment->host_playing.load(std::memory_order_acquire)
+      && (kill(segment->host_pid, 0) == 0 || errno == EPERM);
+  munmap(memory, sizeof(CoopSegment));
+  return alive;
+}
+
+} // namespace
+
+bool CoopHost::start(const std::string & name) {
+  shm_name = shmName(name);
+  int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 && errno == EEXIST) {
+    if (hostAlive(shm_name)) {
+      errno = EADDRINUSE;
+      return false;
+    }
+    // left behind by a host that didn't get to clean up
+    shm_unlink(shm_name.c_str());
+    fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  }
+  if (fd == -1) {
+    return false;
+  }
+  void * memory = MAP_FAILED;
+  if (ftruncate(fd, sizeof(CoopSegment)) == 0) {
+    memory = mmap(nullptr, sizeof(CoopSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  int saved = errno;
+  close(fd);
+  if (memory == MAP_FAILED) {
+    shm_unlink(shm_name.c_str());
+    errno = saved;
+    return false;
+  }
+  segment = new (memory) CoopSegment();
+  segment->frame.partner_x = segment->frame.partner_y = -1;
+  return true;
+}
+
+void CoopHost::stop() {
+  if (!hosting()) {
+    return;
+  }
+  segment->host_playing.store(0, std::memory_order_release);
+  munmap(segment, sizeof(CoopSegment));
+  segment = nullptr;
+  // a partner still attached keeps its mapping until it notices
+  shm_unlink(shm_name.c_str());
+}
+
+bool CoopHost::partnerJoined() const {
+  return hosting() && segment->partner_joined.load(std::memory_order_acquire);
+}
+
+bool CoopHost::popKey(int & key) {
+  return hosting() && segment->partner_keys.pop(key);
+}
+
+void CoopHost::discardKeys() {
+  int key;
+  while (popKey(key)) {
+  }
+}
+
+void CoopHost::publishFrame(const Board & board, int host_x, int host_y, int partner_x, int partner_y) {
+  if (!hosting()) {
+    return;
+  }
+  CoopFrame & f = segment->frame;
+  uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+  segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  int width = std::min(board.getWidth(), MAX_WIDTH);
+  int height = std::min(board.getHeight(), MAX_HEIGHT);
+  if (width != f.width || height != f.height) {
+    f.width = width;
+    f.height = height;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        f.cells[y * width + x] = board.compose(x, y);
+      }
+    }
+  } else {
+    for (int cell : board.lastRendered()) {
+      int x = cell % board.getWidth(), y = cell / board.getWidth();
+      if (x < width && y < height) {
+        f.cells[y * width + x] = board.compose(x, y);
+      }
+    }
+  }
+  f.host_x = host_x;
+  f.host_y = host_y;
+  f.partner_x = partner_x;
+  f.partner_y = partner_y;
+
+  segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void CoopHost::publishHud(const std::string & text) {
+  if (!hosting()) {
+    return;
+  }
+  uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+  segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  size_t length = std::min(text.size(), static_cast<size_t>(HUD_SIZE - 1));
+  memcpy(segment->frame.hud, text.c_str(), length);
+  segment->frame.hud[length] = '\0';
+  segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+namespace {
+
+bool operator!=(const Glyph & a, const Glyph & b) {
+  return a.letter != b.letter || a.wall != b.wall || a.color != b.color;
+}
+
+// the board as the partner sees it: the host in the partner colour, and
+// itself as any player sees its own cell
+Glyph partnerView(const CoopFrame & f, int x, int y) {
+  Glyph g = f.cells[y * f.width + x];
+  if (x == f.host_x && y == f.host_y) {
+    g.color = PARTNER_COLOR;
+  } else if (x == f.partner_x && y == f.partner_y) {
+    g.color = EATEN_COLOR;
+  }
+  return g;
+}
+
+// what the partner's screen shows, to draw only what changed
+struct PartnerScreen {
+  int width = -1;
+  int height = -1;
+  std::vector<Glyph> cells;
+  std::string hud;
+
+  void draw(const CoopFrame & f) {
+    if (f.width != width || f.height != height) {
+      clear();
+      width = f.width;
+      height = f.height;
+      cells.assign(width * height, Glyph{'\0', Wall::None, 0});
+      hud.clear();
+    }
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        Glyph g = partnerView(f, x, y);
+        if (g != cells[y * width + x]) {
+          cells[y * width + x] = g;
+          drawGlyph(x, y, g);
+        }
+      }
+    }
+    if (hud != f.hud) {
+      hud = f.hud;
+      size_t begin = 0;
+      for (int line = 0; line < HUD_LINES; ++line) {
+        size_t end = begin < hud.size() ? hud.find('\n', begin) : std::string::npos;
+        std::string text = begin < hud.size() ? hud.substr(begin, end - begin) : "";
+        // like printAtBottom, where lines after the first start at column 0
+        mvprintw(height + 1 + line, line == 0 ? 1 : 0, "%s", text.c_str());
+        clrtoeol();
+        begin = end == std::string::npos ? hud.size() : end + 1;
+      }
+    }
+    if (f.partner_x >= 0) {
+      move(f.partner_y, f.partner_x);
+    } else {
+      move(f.host_y, f.host_x);
+    }
+  }
+};
+
+} // namespace
+
+int joinGame(const std::string & name) {
+  std::string error;
+  CoopSegment * segment = nullptr;
+  int fd = shm_open(shmName(name).c_str(), O_RDWR, 0);
+  struct stat st;
+  if (fd == -1) {
+    error = "nobody is hosting " + name;
+  } else if (fstat(fd, &st) == -1 || st.st_size < static_cast<off_t>(sizeof(CoopSegment))) {
+    error = "the game hosted as " + name + " is from another version of pacvim";
+  } else {
+    void * memory = mmap(nullptr, sizeof(CoopSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+      error = strerror(errno);
+    } else {
+      segment = static_cast<CoopSegment *>(memory);
+    }
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+  uint32_t nobody = 0;
+  if (segment && (segment->magic != MAGIC || segment->version != VERSION)) {
+    error = "the game hosted as " + name + " is from another version of pacvim";
+  } else if (segment && !segment->partner_joined.compare_exchange_strong(nobody, 1)) {
+    error = "somebody else already joined " + name;
+  }
+  if (!error.empty()) {
+    if (segment) {
+      munmap(segment, sizeof(CoopSegment));
+    }
+    endwin();
+    std::cout << "\nCannot join: " << error << "." << std::endl << std::endl;
+    return 1;
+  }
+
+  mvprintw(0, 0, "Joined %s; :q leaves. Waiting for the host...", name.c_str());
+  refresh();
+  PartnerScreen screen;
+  // a copy, so the host can go on writing while this one is drawn
+  std::unique_ptr<CoopFrame> frame(new CoopFrame());
+  uint32_t drawn = 1; // never a complete sequence number
+  bool pressed_colon = false, leaving = false;
+  while (!leaving && segment->host_playing.load(std::memory_order_acquire)) {
+    int key;
+    while ((key = getch()) != ERR) {
+      if (pressed_colon && key == 'q') {
+        leaving = true;
+      }
+      pressed_colon = key == ':';
+      if (key < KEY_MIN && !pressed_colon) {
+        segment->partner_keys.push(key); // a full queue drops the key
+      }
+    }
+    uint32_t sequence = segment->sequence.load(std::memory_order_acquire);
+    if (sequence != drawn && sequence % 2 == 0) {
+      memcpy(frame.get(), &segment->frame, sizeof(CoopFrame));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (segment->sequence.load(std::memory_order_relaxed) == sequence) {
+        screen.draw(*frame);
+        refresh();
+        drawn = sequence;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  bool host_left = !leaving;
+  segment->partner_joined.store(0, std::memory_order_release);
+  munmap(segment, sizeof(CoopSegment));
+  if (host_left) {
+    endwin();
+    std::cout << "\nThe host has left the game." << std::endl << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef COOP_H
+#define COOP_H
+
+// Two players on one map, on the same machine (say, two tmux panes):
+//   pacvim --host NAME   plays as usual, and lets a partner join
+//   pacvim --join NAME   joins as the partner
+//
+// The host runs the one and only game; the partner is just another entity
+// on its board (PARTNER_ENTITY). Both processes share a memory segment,
+// /pacvim-NAME: the partner pushes its keys into a KeyQueue there, and the
+// host takes them off every frame and writes back what the board looks
+// like. Ghosts go after whichever player is nearest, either player getting
+// caught loses the level, and the lives are shared.
+
+#include <string>
+
+class Board;
+struct CoopSegment;
+
+class CoopHost {
+public:
+  // create the shared segment; false (and errno set) if that failed,
+  // EADDRINUSE if another host that is still running has the name
+  bool start(const std::string & name);
+  // tell the partner the game is over and remove the segment
+  void stop();
+  bool hosting() const { return segment != nullptr; }
+
+  bool partnerJoined() const;
+  // the next key the partner typed, if any
+  bool popKey(int & key);
+  void discardKeys();
+
+  // after every Board::render, like SpectatorServer::publishFrame; the
+  // partner is at -1, -1 while it isn't on the board
+  void publishFrame(const Board & board, int host_x, int host_y, int partner_x, int partner_y);
+  void publishHud(const std::string & text);
+
+private:
+  CoopSegment * segment = nullptr;
+  std::string shm_name;
+};
+
+// the --join loop; returns the exit code
+int joinGame(const std::string & name);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "doors.h"
+#include "globals.h"
+#include "level.h"
+
+#include <vector>
+
+// the doors of the level being played, and which of them are open
+static std::vector<Door> doors;
+static std::vector<unsigned char> open_doors;
+
+static bool isWallCell(int x, int y) {
+  // the line number columns are not walls, whatever is outside the board
+  return x >= 2 && board.inside(x, y) && board.isWall(x, y);
+}
+
+static void reshape(int x, int y) {
+  if (!isWallCell(x, y)) {
+    return;
+  }
+  Terrain t = board.terrainAt(x, y);
+  t.wall = wallShape(isWallCell(x - 1, y), isWallCell(x + 1, y),
+                     isWallCell(x, y - 1), isWallCell(x, y + 1));
+  board.setTerrain(x, y, t);
+}
+
+static void setDoor(int door, bool open, bool force = false) {
+  const Door & d = doors[door];
+  if (!board.inside(d.x, d.y) || open_doors[door] == open) {
+    return;
+  }
+  // nobody gets shut inside a wall; the door stays open until the next try
+  if (!open && !force && board.entityAt(d.x, d.y) != NO_ENTITY) {
+    return;
+  }
+  open_doors[door] = open;
+  Terrain t;
+  if (!open) {
+    t.letter = '#';
+    t.color = DOOR_COLOR;
+    t.wall = Wall::HLine; // reshaped below
+  }
+  board.setTerrain(d.x, d.y, t);
+  reshape(d.x, d.y);
+  reshape(d.x - 1, d.y);
+  reshape(d.x + 1, d.y);
+  reshape(d.x, d.y - 1);
+  reshape(d.x, d.y + 1);
+  level.reachability.setCell(d.x - 2, d.y, open ? ' ' : '#');
+}
+
+void resetDoors() {
+  // Close the doors left open in the reachability map. A new level may
+  // have been loaded since, with a fresh map: only put back walls the
+  // level has, and setCell ignores cells that are a wall already.
+  for (size_t door = 0; door < doors.size(); ++door) {
+    const Door & d = doors[door];
+    if (open_doors[door] && d.x < level.board_width && d.y < level.board_height
+        && level.terrain[d.y * level.board_width + d.x].wall != Wall::None) {
+      level.reachability.setCell(d.x - 2, d.y, '#');
+    }
+  }
+  doors.assign(level.doors.begin(), level.doors.end());
+  open_doors.assign(doors.size(), 0);
+  for (const Door & d : level.doors) {
+    if (board.inside(d.x, d.y)) {
+      Terrain t = board.terrainAt(d.x, d.y);
+      t.color = DOOR_COLOR;
+      board.setTerrain(d.x, d.y, t);
+    }
+    if (board.inside(d.switch_x, d.switch_y) && !board.isWall(d.switch_x, d.switch_y)) {
+      Terrain t = board.terrainAt(d.switch_x, d.switch_y);
+      t.color = DOOR_COLOR;
+      board.setTerrain(d.switch_x, d.switch_y, t);
+    }
+  }
+}
+
+void stepOnSwitch(int x, int y) {
+  for (size_t door = 0; door < doors.size(); ++door) {
+    if (doors[door].switch_x == x && doors[door].switch_y == y) {
+      setDoor(door, !open_doors[door]);
+    }
+  }
+}
+
+int doorCount() {
+  return doors.size();
+}
+
+bool doorOpen(int door) {
+  return door >= 0 && door < static_cast<int>(open_doors.size()) && open_doors[door];
+}
+
+void restoreDoor(int door, bool open) {
+  if (door >= 0 && door < doorCount()) {
+    setDoor(door, open, true);
+  }
+}
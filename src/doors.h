@@ -0,0 +1,39 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef DOORS_H
+#define DOORS_H
+
+// Doors (d lines in a map, see mapFile.h) are walls that open when a player
+// steps on their switch, and close again on the next step. Opening or
+// closing one changes the board's terrain and the level's reachability
+// map, so ghosts, motions and 0/$ see the door as it is now.
+
+// close every door of the level, as at the start; call after the board is
+// loaded with the level's terrain
+void resetDoors();
+// a player arrived at x, y: flip the doors whose switch is there
+void stepOnSwitch(int x, int y);
+int doorCount();
+bool doorOpen(int door);
+// for the rewind history: put a door back as it was at some earlier tick,
+// whoever stands there now (the history puts them back too)
+void restoreDoor(int door, bool open);
+
+#endif
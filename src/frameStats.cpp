@@ -0,0 +1,94 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "frameStats.h"
+#include "helperFns.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void PhaseTimings::add(double ms) {
+  samples[next] = ms;
+  next = (next + 1) % WINDOW;
+  if (count < WINDOW) {
+    ++count;
+  }
+}
+
+double PhaseTimings::min() const {
+  return count == 0 ? 0 : *std::min_element(samples, samples + count);
+}
+
+double PhaseTimings::avg() const {
+  double sum = 0;
+  for (int i = 0; i < count; ++i) {
+    sum += samples[i];
+  }
+  return count == 0 ? 0 : sum / count;
+}
+
+double PhaseTimings::p99() const {
+  if (count == 0) {
+    return 0;
+  }
+  double sorted[WINDOW];
+  std::copy(samples, samples + count, sorted);
+  int rank = (count * 99) / 100;
+  std::nth_element(sorted, sorted + rank, sorted + count);
+  return sorted[rank];
+}
+
+void FrameStats::record(FramePhase phase, double seconds) {
+  phases[static_cast<int>(phase)].add(seconds * 1000);
+}
+
+void FrameStats::recordRedraw(int cells) {
+  cells_redrawn = cells;
+  cells_redrawn_avg += (cells - cells_redrawn_avg) / 64;
+}
+
+// every line has room for the longest, so formatting doesn't allocate
+FrameStats::FrameStats() : lines(PHASE_COUNT + 2) {
+  for (std::string & line : lines) {
+    line.reserve(80);
+  }
+}
+
+const std::vector<std::string> & FrameStats::format() {
+  static const char * names[PHASE_COUNT] = { "input", "ghosts", "hud", "render", "refresh" };
+  char line[80];
+  snprintf(line, sizeof(line), "%-8s %7s %7s %7s  (ms)", "", "min", "avg", "p99");
+  lines[0] = line;
+  for (int p = 0; p < PHASE_COUNT; ++p) {
+    const PhaseTimings & t = phases[p];
+    snprintf(line, sizeof(line), "%-8s %7.3f %7.3f %7.3f", names[p], t.min(), t.avg(), t.p99());
+    lines[p + 1] = line;
+  }
+  snprintf(line, sizeof(line), "ghosts %d, cells drawn %d (avg %.1f)",
+           ghost_count, cells_redrawn, cells_redrawn_avg);
+  lines[PHASE_COUNT + 1] = line;
+  return lines;
+}
+
+PhaseTimer::PhaseTimer(FrameStats & s, FramePhase p) : stats(s), phase(p), start(gameTime()) {
+}
+
+PhaseTimer::~PhaseTimer() {
+  stats.record(phase, gameTime() - start);
+}
@@ -0,0 +1,81 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+// Per-frame timings for the F2 overlay. Every phase of a frame keeps its
+// last WINDOW samples, so the numbers follow what is happening right now;
+// the overlay shows min, average and 99th percentile of each.
+
+#include <string>
+#include <vector>
+
+enum class FramePhase {
+  Input,   // onKeystroke
+  Ghosts,  // Ghosts::update
+  Hud,     // formatting and printing the status lines
+  Render,  // Board::render, drawing changed cells into curses' buffer
+  Refresh, // refresh, writing to the terminal
+};
+const int PHASE_COUNT = 5;
+
+class PhaseTimings {
+  enum { WINDOW = 256 };
+  double samples[WINDOW]; // milliseconds
+  int count = 0;
+  int next = 0;
+
+public:
+  void add(double ms);
+  int size() const { return count; }
+  double min() const;
+  double avg() const;
+  double p99() const;
+};
+
+class FrameStats {
+  PhaseTimings phases[PHASE_COUNT];
+  std::vector<std::string> lines; // what format returns, reused
+
+public:
+  FrameStats();
+  int ghost_count = 0;
+  int cells_redrawn = 0; // in the last frame
+  double cells_redrawn_avg = 0; // moving average over roughly the window
+
+  void record(FramePhase phase, double seconds);
+  void recordRedraw(int cells);
+  // a header, one line per phase and a summary line, all of the same
+  // width; valid until the next call
+  const std::vector<std::string> & format();
+};
+
+// times a scope: PhaseTimer t(stats, FramePhase::Ghosts);
+class PhaseTimer {
+  FrameStats & stats;
+  FramePhase phase;
+  double start;
+
+public:
+  PhaseTimer(FrameStats & s, FramePhase p);
+  ~PhaseTimer();
+};
+
+#endif
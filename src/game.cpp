@@ -20,28 +20,37 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <thread>
 #include <iostream>
-
+#include <iomanip>
+#include <algorithm>
+#include <cerrno>
+#include <clocale>
+#include <cstring>
+#include <random>
+
+#include "allocCheck.h"
 #include "globals.h"
 #include "helperFns.h"
 #include "avatar.h"
 #include "ghost1.h"
+#include "frameStats.h"
+#include "keystroke.h"
+#include "lint.h"
+#include "rewind.h"
+#include "trace.h"
+#include "mapFile.h"
+#include "level.h"
+#include "doors.h"
+#include "spectate.h"
+#include "coop.h"
+#include "tournament.h"
+#include "bot.h"
+#include "generator.h"
+#include "mapWatcher.h"
+#include "scanBench.h"
+#include "game.h"
 
 using namespace std;
 
-// changed in DrawScreen and used when spawning the player
-int START_X = 1;
-int START_Y = 1;
-
-// ghosts from text file
-struct ghostInfo {
-	double think;
-	int xPos;
-	int yPos;
-	Ghost_Species species;
-};
-vector<ghostInfo> ghostList;
-
-
 void gotoLineBeginning(int line, avatar &unit) {
 	int x = 2;
 	while(mvinch(x, line) == '#' ) {
@@ -50,7 +59,7 @@ void gotoLineBeginning(int line, avatar &unit) {
 	unit.moveTo(x, line);
 }
 
-void onKeystroke(avatar& unit, char key);
+Keystroke onKeystroke(avatar& unit, char key);
 
 // true if string only contains digits...regex would be nice
 bool isFullDigits(string &str) {
@@ -63,7 +72,7 @@ bool isFullDigits(string &str) {
 
 void jumpToFirstReachableLine(avatar & unit, int lineNumber, bool searchForwards) {
   int real_line_number = find_reachable_line(lineNumber, searchForwards);
-  int x_start_of_line = reachability_map.first_reachable_index_on_line(real_line_number);
+  int x_start_of_line = level.reachability.first_reachable_index_on_line(real_line_number);
   if (x_start_of_line != -1) {
 	  unit.moveTo(x_start_of_line, real_line_number);
   } else {
@@ -71,211 +80,268 @@ void jumpToFirstReachableLine(avatar & unit, int lineNumber, bool searchForwards
   }
 }
 
+// --watch: the socket of the game to watch instead of playing
+string WATCH_SOCKET;
+// --join: the name of the game to play along with instead
+string JOIN_NAME;
+// --dev: the map being edited, and what happened to the last save
+string DEV_MAP;
+string DEV_STATUS;
+// the partner's command being typed, in a --host game
+KeyParser PARTNER_INPUT;
+
 void quit_game() {
 	endwin();
+	spectators.stop();
+	coop.stop();
+	mapWatcher.stop();
+	writeLatencyReport();
+	writeTrace();
 	exit(0);
 }
 
-void doKeystroke(avatar& unit, int repeats = 1) {
-	if(INPUT== "q") {
+void doKeystroke(avatar& unit, const Keystroke & keystroke) {
+	TRACE_SPAN("doKeystroke");
+	int repeats = keystroke.count;
+	bool time_travel = keystroke.command == Command::Undo || keystroke.command == Command::Redo;
+	if (PRACTICE_MODE && !time_travel && keystroke.command != Command::None) {
+		history.resume(); // play on from the tick on the screen
+	}
+	switch (keystroke.command) {
+	case Command::None:
+		return;
+	case Command::Quit:
 	  writeError("User is attempting to quit vim (should be :q, not q)");
 	  // but let's not tell him in-game
 		return;
-	}
-	else if(INPUT == "h") {
+	case Command::Left:
 		unit.moveLeft(repeats);
-	}
-	else if(INPUT == "j") {
+		break;
+	case Command::Down:
 		unit.moveDown(repeats);
-	}
-	else if(INPUT == "k") {
+		break;
+	case Command::Up:
 		unit.moveUp(repeats);
-	}
-	else if(INPUT == "l") {
+		break;
+	case Command::Right:
 		unit.moveRight(repeats);
-	}
-	else if(INPUT == "w") {
+		break;
+	case Command::WordForward:
 		unit.parseWordForward(false, repeats);
-	}
-	else if(INPUT == "W") {
+		break;
+	case Command::BigWordForward:
 		unit.parseWordForward(true, repeats);
-	}
-	else if(INPUT == "b") {
+		break;
+	case Command::WordBackward:
 		unit.parseWordBackward(false, repeats);
-	}
-	else if(INPUT == "B") {
+		break;
+	case Command::BigWordBackward:
 		unit.parseWordBackward(true, repeats);
-	}
-	else if(INPUT == "E") {
+		break;
+	case Command::BigWordEnd:
 		unit.parseWordEnd(true, repeats);
-	}
-	else if(INPUT == "e") {
+		break;
+	case Command::WordEnd:
 		unit.parseWordEnd(false, repeats);
-	}
-	else if(INPUT == "$") { 
+		break;
+	case Command::LineEnd:
 		unit.jumpToEnd(repeats); 
-	}
-	else if(INPUT == "0") {
+		break;
+	case Command::LineBegin:
 		unit.jumpToBeginning();
-	}
-	else if(INPUT == "%") {
+		break;
+	case Command::Percent:
 	  unit.percentJump();
-	}
-	else if(INPUT.size() == 2 && (INPUT[0] == 'f')){
-	  unit.jumpForward(INPUT[1], true, false, repeats);
-    lastJumpWasForwards = true;
-    lastJumpIncludedTarget = true;
-    lastJumpChar = INPUT[1];
-	}
-	else if(INPUT.size() == 2 && (INPUT[0] == 'F')){
-	  unit.jumpBackward(INPUT[1], true, false, repeats);
-    lastJumpWasForwards = false;
-    lastJumpIncludedTarget = true;
-    lastJumpChar = INPUT[1];
-	}
-	else if(INPUT.size() == 2 && (INPUT[0] == 't')){
-	  writeError(std::to_string(repeats));
-	  unit.jumpForward(INPUT[1], false, false, repeats);
-    lastJumpWasForwards = true;
-    lastJumpIncludedTarget = false;
-    lastJumpChar = INPUT[1];
-	}
-	else if(INPUT.size() == 2 && (INPUT[0] == 'T')){
-	  unit.jumpBackward(INPUT[1], false, false, repeats);
-    lastJumpWasForwards = false;
-    lastJumpIncludedTarget = false;
-    lastJumpChar = INPUT[1];
-	}
-	else if(INPUT == ";") {
-	  if (lastJumpChar == '\0') {
-	    INPUT = "";
-	    return;
+	  break;
+	case Command::FindForward:
+	case Command::FindBackward:
+	case Command::TillForward:
+	case Command::TillBackward:
+	  lastJumpWasForwards = keystroke.command == Command::FindForward
+	                     || keystroke.command == Command::TillForward;
+	  lastJumpIncludedTarget = keystroke.command == Command::FindForward
+	                        || keystroke.command == Command::FindBackward;
+	  lastJumpChar = keystroke.target;
+	  if (lastJumpWasForwards) {
+	    unit.jumpForward(lastJumpChar, lastJumpIncludedTarget, false, repeats);
+	  } else {
+	    unit.jumpBackward(lastJumpChar, lastJumpIncludedTarget, false, repeats);
 	  }
-    // jumpToChar(char targetChar, bool forward, bool includingTarget, bool acrossWalls) {
-		unit.jumpToChar(lastJumpChar, lastJumpWasForwards, lastJumpIncludedTarget, false, repeats);
-	}
-	else if(INPUT == ",") {
+	  break;
+	case Command::RepeatFind:
+	case Command::RepeatFindReverse:
 	  if (lastJumpChar == '\0') {
-	    INPUT = "";
 	    return;
 	  }
-    // jumpToChar(char targetChar, bool forward, bool includingTarget, bool acrossWalls) {
-		unit.jumpToChar(lastJumpChar, !lastJumpWasForwards, lastJumpIncludedTarget, false, repeats);
-	}
-	else if(INPUT == "gg" || INPUT == "1G" || INPUT == "H") {
+	  // jumpToChar(char32_t targetChar, bool forward, bool includingTarget, bool acrossWalls) {
+		unit.jumpToChar(lastJumpChar, lastJumpWasForwards == (keystroke.command == Command::RepeatFind),
+		                lastJumpIncludedTarget, false, repeats);
+		break;
+	case Command::GotoLine:
 	  jumpToFirstReachableLine(unit, repeats, false);
-	  INPUT="";
-	}
-	else if(INPUT == "G" || INPUT == "L") { 
+	  break;
+	case Command::LastLine:
 	  jumpToFirstReachableLine(unit, MAP_END - MAP_BEGIN, false);
-	  INPUT="";
-	}
-	else if(INPUT == "M") { 
+	  break;
+	case Command::MiddleLine:
 	  jumpToFirstReachableLine(unit, MAP_BEGIN + (MAP_END - MAP_BEGIN) / 2, true);
-	  INPUT="";
-	}
-	else if(INPUT == "^") {
+	  break;
+	case Command::FirstNonBlank: {
 		// goes to first character after blank
 		unit.jumpToBeginning();
 
-		char currentChar = charAt(unit.getX(), unit.getY());
+		char32_t currentChar = letterAt(unit.getX(), unit.getY());
 		if (currentChar == ' ') {
 			unit.parseWordForward(true, repeats);
 		}
+		break;
 	}
-	else if(INPUT == "!") {
+	case Command::ToggleFreeze:
 	  FREEZE_GHOSTS = 1 - FREEZE_GHOSTS;
-	}
-	else if(INPUT == "&") {
+	  break;
+	case Command::Cheat:
 		GAME_WON = 1; // l337 cheetz
+		break;
+	case Command::Undo:
+		if (PRACTICE_MODE) {
+			history.undo(repeats, gameTime());
+		}
+		break;
+	case Command::Redo:
+		if (PRACTICE_MODE) {
+			history.redo(repeats, gameTime());
+		}
+		break;
 	}
 }
 
-void onKeystroke(avatar& unit, char key) {
-	writeError("CURRENT INPUT: " + INPUT + key);
-
-	// there are some weird edge cases which I want to handle here:
-	// 1. #G [moves to line #]
-	// 2. 1G = same as gg
-	// 3. gg = beginning of file... it's weird bc it's two non-digit characters
-	// 4. fx = for any x character, jump forward to it, Fx for backward
-
-	// if f/F/t/T was pressed, allow every character
-	int input_size = INPUT.size();
-	char last_input = '\0';
-	if (input_size > 0) {
-	  last_input = INPUT[input_size-1];
-	}
-	if(input_size >= 1 && (last_input == 'f' || last_input == 'F'
-	                      || last_input == 't' || last_input == 'T')) {
-	  int repeats = 1;
-	  if (input_size > 1) {
-      repeats = std::stoi(INPUT, nullptr, 0);
-	  }
-	  INPUT = {last_input, key};
-	  doKeystroke(unit, repeats);
-	  INPUT = "";
-	}
-	else if(key == 'g') { 
-	  if (last_input == 'g') {
-	    int repeats = 1;
-	    if (isdigit(INPUT[0])) {
-        repeats = std::stoi(INPUT, nullptr, 0);
-      }
-      INPUT = "gg";
-      doKeystroke(unit, repeats);
-      INPUT = "";
-	  } else {
-	    INPUT += key;
-	  }
+// feeds the key to the parser; the command runs once it is complete
+// (3w runs on the w, fx on the x, 12gg on the second g)
+Keystroke onKeystroke(avatar& unit, char key) {
+	TRACE_SPAN("onKeystroke");
+	Keystroke keystroke = INPUT.feed(key);
+	doKeystroke(unit, keystroke);
+	return keystroke;
+}
+
+// --host: put the partner on the board once it has joined, next to where
+// the player starts, and take it off again when it has left. Its points
+// stay with the team either way.
+void updatePartner() {
+	int x, y;
+	bool playing = board.position(PARTNER_ENTITY, x, y);
+	if (coop.partnerJoined() == playing) {
+		return;
 	}
-	// If INPUT != empty, and the user inputs a number, INPUT
-	// should reset.. EG: 3g3 dd = 1 dd, not 3 dd
-	else if(!INPUT.empty() && isdigit(key) && !isFullDigits(INPUT)) {
-		// reset it.. can't enter a digit in the middle of input
-		INPUT = "";
+	if (playing) {
+		board.remove(PARTNER_ENTITY);
+		return;
 	}
-	// we have full digits and then enter a character
-	else if(!INPUT.empty() && isFullDigits(INPUT) && !isdigit(key)) {
-		// special, wait for next key
-		if(key == 'f' || key == 'F' || key == 't' || key == 'T' || key == 'g') {
-		  INPUT += key;
-		  return;
+	for (int offset = 1; offset < WIDTH; ++offset) {
+		for (int side : {1, -1}) {
+			x = level.start_x + side * offset;
+			y = level.start_y;
+			if (board.isValid(x, y) && board.letter(x, y) != '~' && board.entityAt(x, y) == NO_ENTITY) {
+				partner.restore(x, y, partner.getPoints());
+				partner.moveTo(x, y); // eats the cell, like spawning does
+				PARTNER_INPUT.reset();
+				return;
+			}
 		}
+	}
+}
 
-		int num = std::stoi(INPUT, nullptr, 0); // extracts 33 from 33dd for example
-		
-		// special ... #G. Move to the line number #
-		if(key == 'G') {
-			INPUT = "";
-	    jumpToFirstReachableLine(unit, num, false);
-			refresh();
-			return;
+// what was just rendered, for whoever watches or plays along
+void publishFrame() {
+	spectators.publishFrame(board, player.getX(), player.getY());
+	int partner_x = -1, partner_y = -1;
+	board.position(PARTNER_ENTITY, partner_x, partner_y);
+	coop.publishFrame(board, player.getX(), player.getY(), partner_x, partner_y);
+}
+
+// the globals and the board as the level has them at the start
+void useLevel() {
+	WIDTH = level.width;
+	MAP_BEGIN = level.map_begin;
+	MAP_END = level.map_end;
+	TOTAL_POINTS = level.total_points;
+	board.loadTerrain(level.board_width, level.board_height, level.terrain.data());
+	resetDoors();
+}
+
+// --dev: swap in the map as it was last saved. Cells that still have the
+// same letter stay eaten, the player stays where it is if it still can,
+// and so do the ghosts if their lines didn't change.
+void applyReload() {
+	AllocExempt exempt; // a new level is a new start
+	MapWatcher::Reload reload;
+	if (!mapWatcher.takeReload(reload)) {
+		return;
+	}
+	for (const string & problem : reload.problems) {
+		writeError(problem);
+	}
+	if (reload.level.path.empty()) {
+		DEV_STATUS = " Cannot read " + DEV_MAP + ", still playing the old one";
+		return;
+	}
+	struct EatenCell { int x, y; char32_t letter; };
+	vector<EatenCell> eaten;
+	for (int y = 0; y < board.getHeight(); ++y) {
+		for (int x = 0; x < board.getWidth(); ++x) {
+			if (board.isEaten(x, y)) {
+				eaten.push_back({x, y, board.letter(x, y)});
+			}
 		}
-		// if the input is NOT G, then it means
-		// we are repeating a keystroke.. eg 3w = w, three times
-	
-		INPUT = key; 
-		doKeystroke(unit, num);
-		INPUT = "";
 	}
-	else {
-		// the first time we enter something
-		INPUT += key;
+	bool same_ghosts = reload.level.ghosts.size() == level.ghosts.size()
+		&& std::equal(level.ghosts.begin(), level.ghosts.end(), reload.level.ghosts.begin(),
+			[](const GhostSpawn & a, const GhostSpawn & b) {
+				return a.species == b.species && a.think == b.think && a.x == b.x && a.y == b.y;
+			});
+	vector<GhostState> ghost_states;
+	for (size_t i = 0; same_ghosts && i < ghosts.size(); ++i) {
+		ghost_states.push_back(ghosts.state(i));
+	}
+	int x = player.getX(), y = player.getY();
 
-		if(INPUT.size() == 2 && (INPUT[0] == 'f' || INPUT[0] == 'F'
-		                      || INPUT[0] == 't' || INPUT[0] == 'T')){
-			doKeystroke(unit);
-			INPUT = "";
+	level = std::move(reload.level);
+	useLevel();
+	clear();
+	int points = 0;
+	for (const EatenCell & cell : eaten) {
+		if (board.terrainAt(cell.x, cell.y).point && board.letter(cell.x, cell.y) == cell.letter) {
+			board.eat(cell.x, cell.y);
+			points++;
 		}
-		// do keystroke if the first character is a letter,
-		//  or 0 or % or ; or , (which also immediately moves the player)
-		if(INPUT == ";" || INPUT == "," || INPUT == "0" || INPUT == "%" || (!isFullDigits(INPUT) && INPUT != "f" && INPUT != "F" && INPUT != "t" && INPUT != "T")) {
-			doKeystroke(unit);
-			INPUT = "";
+	}
+	for (size_t i = 0; i < ghost_states.size(); ++i) {
+		same_ghosts &= !board.isWall(ghost_states[i].x, ghost_states[i].y);
+	}
+	if (same_ghosts) {
+		for (size_t i = 0; i < ghost_states.size(); ++i) {
+			ghosts.restore(i, ghost_states[i], gameTime());
 		}
+	} else {
+		ghosts.spawn(level.ghosts.data(), level.ghosts.size(), THINK_MULTIPLIER, gameTime());
 	}
-	refresh();
+	if (!board.isValid(x, y) || board.letter(x, y) == '~' || board.ghostAt(x, y)) {
+		x = level.start_x;
+		y = level.start_y;
+	}
+	player.restore(x, y, points);
+	player.moveTo(x, y); // eats the cell, like spawning does
+	if (PRACTICE_MODE) {
+		history.start();
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(MapWatcher::Clock::now() - reload.saved).count();
+	stringstream status;
+	status << " Reloaded " << DEV_MAP << " " << std::fixed << std::setprecision(1) << ms << " ms after saving";
+	if (!reload.problems.empty()) {
+		status << ", " << reload.problems.size() << " problem(s) in errors.log";
+	}
+	DEV_STATUS = status.str();
 }
 
 // called right before a level loads
@@ -300,235 +366,18 @@ void levelMessage() {
 	refresh();
 }
 
-// loads the level, essentially
+// loads the level, essentially. The map file is only read and analysed
+// when it differs from the last one; trying a level again just copies the
+// terrain back onto the board.
 void drawScreen(const char* file) {
+	TRACE_SPAN("drawScreen");
 	levelMessage();
 	clear();
-	
-	ifstream in(file);
-
-	// clear ghostList because we are gonna obtain new ones
-	ghostList.clear();
-
-	// clear reachability map
-	reachability_map.clear();
 
-	vector<vector <chtype> > board;
-	vector<string> boardStr;
-	string str;
-	vector<chtype> line;
-
-  writeError("LOADING MAP:");
-	// store lines from text file into 'board' and 'boardStr'
-	WIDTH = 0; // largest width in the map
-	while(getline(in, str)) {
-	  if (str.empty() || (str[0] != 'p' && str[0] != '/' && str[0] != 'r' && str[0] != 'c' && str[0] != 'a')) {
-	    reachability_map.addLine(str);
-	  }
-    writeError(str);
-		for(unsigned i = 0; i < str.length(); i++) {
-			line.push_back(str[i]);
-		}
-		boardStr.push_back(str);
-		board.push_back(line);
-		line.clear();
-
-		if (WIDTH < str.length())
-			WIDTH = str.length();
+	if (level.path != file && !loadLevel(file, level)) {
+		writeError(string("Could not open map ") + file);
 	}
-	writeError("Done loading map");
-	
-	// add spaces automatically to lines that don't have
-	// the max length (specified by WIDTH). Errors will
-	// happen if the board does not have a constant length
-	for(unsigned i = 0; i < board.size(); i++) {
-		boardStr.at(i).resize(WIDTH, 0x00A0); 
-		for(unsigned j = board.at(i).size(); j < WIDTH; j++) { 
-			chtype empty = ' ';
-			board.at(i).push_back(empty);
-		}
-	}
-	in.close();
-
-  bool player_start_specified = false;
-
-	// iterate thru each line, parse, create board, create ghost attributes 
-	for(unsigned i = 0; i < board.size(); i++) {
-
-		string str = boardStr.at(i);
-		// parse info about ghosts, add them to ghostlist
-		if(str.at(0) == '/' || str.at(0) == 'r' || str.at(0) == 'a' || str.at(0) == 'c' || str.at(0) == 's') {
-			// format: *type**thinkTime* *x-position* *y-position* -- delimited by spaces ofc
-			// EG: /1.5 19 7
-
-			// create the ghost
-			ghostInfo ghost;
-			char ghost_id = str.at(0);
-			switch(ghost_id) {
-			  case '/':
-			    ghost.species = Ghost_Species::Seeker;
-			    break;
-			  case 'r':
-			    ghost.species = Ghost_Species::Lemming;
-			    break;
-			  case 'c':
-			    ghost.species = Ghost_Species::Clockwise_Lemming;
-			    break;
-			  case 'a':
-			    ghost.species = Ghost_Species::AntiClockwise_Lemming;
-			    break;
-			  case 's':
-			    ghost.species = Ghost_Species::Agent_Smith;
-			    break;
-			  default:
-			    writeError("Invalid ghost species in map definition, must be / for normal ghost, r for random lemming, c or a for (anti)clockwise lemming!");
-			    ghost.species = Ghost_Species::Seeker;
-			}
-
-			str.erase(str.begin(), str.begin()+1);
-
-			string a = str.substr(0, str.find(" "));
-			str = str.substr(str.find(" ")+1, 9); // 9 is kinda arbitrary (should be > str length)
-
-			string b = str.substr(0, str.find(" "));
-			str = str.substr(str.find(" ")+1, 9);
-
-			string c = str.substr(0, str.find(" "));
-			str = str.substr(str.find(" ")+1, 9);
-		
-			ghost.think = stod(a, nullptr);
-			ghost.xPos = stoi(b, nullptr, 0) + 2;
-			ghost.yPos = stoi(c, nullptr, 0);
-			ghostList.push_back(ghost);
-			continue;
-		} else if(str.at(0) == 'p') {
-		// this is where the player starting position is handled 
-      player_start_specified = true;
-
-			str.erase(str.begin(), str.begin()+1); 
-
-			// get x position
-			string x = str.substr(0, str.find(" "));
-			str = str.substr(str.find(" ")+1, 9); // delete up to space
-
-			string y = str.substr(0, str.find(" "));
-			str = str.substr(str.find(" ")+1, 9); // delete up to space
-
-			START_X = stoi(x, nullptr, 0) + 2;
-			START_Y = stoi(y, nullptr, 0);
-			continue;
-		}
-		// add line numbers
-		if (reachability_map.first_reachable_index_on_line(i) == -1) {
-		  // lines that can't be jumped to are not labeled with linenumber
-		  addch(' ');
-		  addch(' ');
-		} else {
-			attron(COLOR_PAIR(8)); // line numbers
-      string line_number = to_string(i);
-      if (line_number.length() < 2) {
-		    addch(' ');
-		  }
-		  for (unsigned j = 0; j < 2 && j < line_number.length(); j++) {
-		    addch(line_number[j]);
-		  }
-			attroff(COLOR_PAIR(8));
-		}
-		// this is where we actually draw the board
-		for(unsigned j = 0; j < board.at(i).size(); j++) {
-
-			// TOTAL_POINTS is incremented by 1 if a letter is found;
-			// it represents the number of letters the player has to step on to win
-			if(board.at(i).at(j) != '~' && 
-				board.at(i).at(j) != ' ' &&  board.at(i).at(j) != '#') 
-				TOTAL_POINTS++;
-
-
-			// Check for walls -- the wall character depends on the position
-			// of the other walls. EG: is the wall a corner, a straight line, etc?
-			bool left = false, right = false,
-				up = false, down = false;
-			chtype* ch = &( board.at(i).at(j));
-			// Check left
-			if(j >= 1) {
-				if(board.at(i).at(j-1) == '#') {
-					left = true;
-				}
-			}
-			// Check right
-			if((j+1) < (board.at(i).size())) {
-				if(board.at(i).at(j + 1) == '#') {
-					right = true;
-				}
-			}
-			// Check up
-			if(i >= 1) {
-				if(board.at(i - 1).at(j) == '#') {
-					up = true;
-				}
-			}
-			// Check down
-			if((i+2) < (board.size())) {
-				if(board.at(i+1).at(j) == '#') {
-					down = true;
-				}
-			}
-                                
-			// add the appropriate wall 
-			if(*ch == '#') {
-				attron(COLOR_PAIR(3)); // yellow, but can change
-				if(left && right && up && down)
-					addch(ACS_PLUS); 
-				else if(left && right && up)
-					addch(ACS_BTEE); 
-				else if(left && right && down)
-					addch(ACS_TTEE); 
-				else if(left && up && down)
-					addch(ACS_RTEE); 
-				else if(right && up && down)
-					addch(ACS_LTEE); 
-				else if(up && left)
-					addch(ACS_LRCORNER); 
-				else if(up && right)
-					addch(ACS_LLCORNER); 
-				else if(down && left)
-					addch(ACS_URCORNER); 
-				else if(down && right)
-					addch(ACS_ULCORNER); 
-				else if(down || up)
-					addch(ACS_VLINE); 
-				else 
-					addch(ACS_HLINE); 
-				attroff(COLOR_PAIR(3));
-			}
-			else {
-				// special color for tilde keys
-				if(*ch == '~') {
-					attron(COLOR_PAIR(6));
-				}
-				addch(*ch);
-				// uncomment this instead of the above line to show reachability map:
-				// if (reachability_map.reachable(j, i)) {
-				//   addch('.');
-				// } else {
-				//   addch('x');
-				// }
-				attroff(COLOR_PAIR(6));
-			}
-		}
-		// set value of MAP_BEGIN - which is the first row
-		//	in which a player can move in
-		if (MAP_BEGIN == 0 && reachability_map.first_reachable_index_on_line(i) != -1) {
-		  MAP_BEGIN = i;
-		}
-		MAP_END++;
-		addch('\n');
-	}
-	if (!player_start_specified) {
-    // in case 'p' is not specified, set the default here
-    START_X = WIDTH/2 + 2;
-    START_Y = HEIGHT/2;
-  }
+	useLevel();
 }
 
 
@@ -546,6 +395,9 @@ void defineColors() {
 }
 
 
+// most keys handled in one frame; the rest wait for the next one
+const int KEYS_PER_FRAME = 64;
+
 void playGame(time_t lastTime, avatar &player) {
 	// consume any inputs in the buffer, or else the inputs will affect
 	// the game right as it begins by moving the player 
@@ -574,41 +426,158 @@ void playGame(time_t lastTime, avatar &player) {
 		}
 	}
 	printAtBottom("GO!                  \n                       ");
-	char key;
+	coop.discardKeys(); // typed while waiting for the host
+	int key;
+	FrameStats stats;
+	int timing_lines = 0; // how many overlay lines are on the screen
+	// keys read this frame and when, waiting for the frame to be flushed
+	std::vector<std::pair<const char *, double>> unflushed_keys;
+	unflushed_keys.reserve(KEYS_PER_FRAME);
+	// the lines under the board, built again every frame
+	string hud;
+	hud.reserve(1024);
 	
 	pressed_colon = false;
+	// in practice mode getting caught pauses the game, to rewind it with u
+	bool gave_up = false;
+	auto waitingForRewind = [&]() {
+		return PRACTICE_MODE && GAME_WON == -1 && !gave_up && history.canUndo();
+	};
 	// continue playing until the player hits q or the game is over
-	while(GAME_WON == 0) {
-		key = getch();
-	  if (key != ERR) {
-		  if (pressed_colon && key == 'q') {
-			  quit_game();
-		  }
-		  if(key == ':'){
-        pressed_colon = true;
-		  } else {
-		    pressed_colon = false;
-		    // A char was received
-		    onKeystroke(player, key);
+	while(GAME_WON == 0 || waitingForRewind()) {
+		AllocCheck check("a playGame frame");
+		// take every key typed since the last frame, so a burst of keys (or
+		// pasted text) lands in one frame instead of one key per frame. The
+		// keys are applied one by one, in order; once one of them ends the
+		// game the rest are left unread.
+		double input_start = gameTime();
+		bool handled_keys = false;
+		for (int keys_read = 0; keys_read < KEYS_PER_FRAME && (GAME_WON == 0 || waitingForRewind()); ++keys_read) {
+			key = getch();
+			if (key == ERR) {
+				break;
+			}
+			double read_time = gameTime();
+			if (key == KEY_F(2)) {
+				SHOW_TIMINGS = !SHOW_TIMINGS;
+			} else if (key < KEY_MIN) {
+			  if (pressed_colon && key == 'q') {
+				  quit_game();
+			  }
+			  if(key == ':'){
+	        pressed_colon = true;
+			  } else {
+			    pressed_colon = false;
+			    if (GAME_WON == -1 && !isdigit(key) && key != 'u' && key != 0x12) {
+			      gave_up = true; // caught, and not rewinding: take the loss
+			      break;
+			    }
+			    // A char was received
+			    Keystroke keystroke = onKeystroke(player, key);
+			    const char * name = keystrokeName(keystroke, INPUT.pending());
+			    unflushed_keys.push_back(std::make_pair(name, read_time));
+			    spectators.publishKey(name);
+			    handled_keys = true;
+			  }
 		  }
-	  }
-
-		stringstream ss;
+		}
+		if (mapWatcher.watching()) {
+			applyReload();
+		}
+		if (coop.hosting()) {
+			updatePartner();
+			int partner_key, x, y;
+			while (GAME_WON == 0 && coop.popKey(partner_key)) {
+				if (board.position(PARTNER_ENTITY, x, y)) {
+					doKeystroke(partner, PARTNER_INPUT.feed(partner_key));
+					handled_keys = true;
+				}
+			}
+		}
+		if (handled_keys) {
+			stats.record(FramePhase::Input, gameTime() - input_start);
+		}
 
-		// increment points as game progresses
-		ss << "Points: " << player.getPoints() << "/" 
-			<< TOTAL_POINTS << "\n" << " Lives: " << LIVES << "\n";
-		if(GAME_WON == 0) {
-			printAtBottom(ss.str());
+		{
+			PhaseTimer timer(stats, FramePhase::Hud);
+			// snprintf into a buffer and hud's own space: this runs every
+			// frame, and must not allocate
+			char line[128];
+
+			// increment points as game progresses
+			snprintf(line, sizeof(line), "Points: %d/%d", teamPoints(), TOTAL_POINTS);
+			hud = line;
+			if (coop.hosting()) {
+				snprintf(line, sizeof(line), " (host %d, partner %d)", player.getPoints(), partner.getPoints());
+				hud += line;
+			}
+			snprintf(line, sizeof(line), "\n Lives: %d\n", LIVES);
+			hud += line;
+			if (PRACTICE_MODE) {
+				char practice[96];
+				if (GAME_WON == -1) {
+					snprintf(practice, sizeof(practice), " CAUGHT! u rewinds, any other key gives up");
+				} else if (history.rewound()) {
+					snprintf(practice, sizeof(practice), " Rewound %lld/%lld ticks: u and ^R step, moving plays on",
+					         history.ticksBack(), history.ticksStored());
+				} else {
+					snprintf(practice, sizeof(practice), " Practice mode: u rewinds");
+				}
+				// exactly 64 wide, to wipe out a longer previous line
+				snprintf(line, sizeof(line), "%-64.64s\n", practice);
+				hud += line;
+			}
+			if (mapWatcher.watching()) {
+				hud += DEV_STATUS;
+				if (DEV_STATUS.size() < 80) {
+					hud.append(80 - DEV_STATUS.size(), ' ');
+				}
+				hud += '\n';
+			}
+			if(GAME_WON == 0 || waitingForRewind()) {
+				printAtBottom(hud);
+				spectators.publishHud(hud);
+				coop.publishHud(hud);
+				if (SHOW_TIMINGS) {
+					stats.ghost_count = ghosts.size();
+					const std::vector<std::string> & lines = stats.format();
+					printTimings(lines);
+					timing_lines = lines.size();
+				} else if (timing_lines > 0) {
+					clearTimings(timing_lines);
+					timing_lines = 0;
+				}
+			}
 		}
 
-		// redundant movement
-		move(player.getY(), player.getX());
+		{
+			PhaseTimer timer(stats, FramePhase::Ghosts);
+			if (!PRACTICE_MODE) {
+				ghosts.update(gameTime());
+			} else if (!history.rewound()) {
+				ghosts.update(gameTime());
+				history.record();
+			}
+		}
 
-		for (auto & ghost : ghosts) {
-		  ghost.think();
+		// draw what changed, then put the cursor back on the player
+		{
+			PhaseTimer timer(stats, FramePhase::Render);
+			TRACE_SPAN("Board::render");
+			stats.recordRedraw(board.render());
+			move(player.getY(), player.getX());
+			publishFrame();
 		}
-		refresh();
+		{
+			PhaseTimer timer(stats, FramePhase::Refresh);
+			TRACE_SPAN("refresh");
+			refresh();
+		}
+		double flush_time = gameTime();
+		for (auto & key_read : unflushed_keys) {
+			latency_stats.record(key_read.first, key_read.second, flush_time);
+		}
+		unflushed_keys.clear();
     std::this_thread::sleep_for(std::chrono::milliseconds(5));
 	}
 	
@@ -631,6 +600,8 @@ void init(const char* mapName) {
   lastJumpWasForwards = true;
   lastJumpIncludedTarget = true;
   lastJumpChar = '\0';
+  INPUT.reset();
+	PARTNER_INPUT.reset();
 	drawScreen(mapName);
 
   std::stringstream ss;
@@ -640,15 +611,21 @@ void init(const char* mapName) {
 	
 
 	// create player
-	player.spawn(START_X, START_Y);
+	player.spawn(level.start_x, level.start_y);
 
 	// spawn ghosts	
-	for(auto ghost_info : ghostList){
-	  double think_time = THINK_MULTIPLIER * ghost_info.think;
-	  auto newGhost = Ghost1(ghost_info.species, think_time);
-	  newGhost.spawn(ghost_info.xPos, ghost_info.yPos);
-	  ghosts.push_back(newGhost);
-	}
+	ghosts.spawn(level.ghosts.data(), level.ghosts.size(), THINK_MULTIPLIER, gameTime());
+
+	// and the partner, if there is one (points start over every level)
+	partner.despawn();
+	updatePartner();
+	if (PRACTICE_MODE) {
+		history.start();
+	}
+	board.render();
+	move(player.getY(), player.getX());
+	publishFrame();
+	coop.publishHud(" Waiting for the host to press ENTER...");
 	
 	// begin game	
 	playGame(time(0), player);
@@ -671,7 +648,83 @@ bool checkParams(int argc, char** argv) {
 	{
 		string currentParam = params[i];
 
-		if (isFullDigits(currentParam)) // level select
+		if (currentParam == "--latency-report") // where to write the latency report
+		{
+			if (i + 1 >= params.size()) {
+				endwin();
+				cout << "\n--latency-report needs a file name." << endl << endl;
+				return false;
+			}
+			LATENCY_REPORT_FILE = params[++i];
+		}
+		else if (currentParam == "--practice") // u and Ctrl-R rewind time
+		{
+			PRACTICE_MODE = true;
+		}
+		else if (currentParam == "--serve" || currentParam == "--watch") // spectators on this machine
+		{
+			if (i + 1 >= params.size()) {
+				endwin();
+				cout << "\n" << currentParam << " needs a socket path." << endl << endl;
+				return false;
+			}
+			string socket_path = params[++i];
+			if (currentParam == "--watch") {
+				WATCH_SOCKET = socket_path;
+			} else if (!spectators.start(socket_path)) {
+				endwin();
+				cout << "\nCannot serve on " << socket_path << ": " << strerror(errno) << endl << endl;
+				return false;
+			}
+		}
+		else if (currentParam == "--host" || currentParam == "--join") // two players, one map
+		{
+			if (i + 1 >= params.size()) {
+				endwin();
+				cout << "\n" << currentParam << " needs a name for the game." << endl << endl;
+				return false;
+			}
+			string name = params[++i];
+			if (currentParam == "--join") {
+				JOIN_NAME = name;
+			} else if (!coop.start(name)) {
+				endwin();
+				cout << "\nCannot host " << name << ": "
+				     << (errno == EADDRINUSE ? "name in use by another pacvim --host" : strerror(errno))
+				     << endl << endl;
+				return false;
+			}
+		}
+		else if (currentParam == "--dev") // play one map, reloading it on every save
+		{
+			if (i + 1 >= params.size()) {
+				endwin();
+				cout << "\n--dev needs a map file." << endl << endl;
+				return false;
+			}
+			DEV_MAP = params[++i];
+			if (!loadLevel(DEV_MAP, level)) {
+				endwin();
+				cout << "\nCannot read " << DEV_MAP << "." << endl << endl;
+				return false;
+			}
+			if (!mapWatcher.start(DEV_MAP)) {
+				endwin();
+				cout << "\nCannot watch " << DEV_MAP << ": " << strerror(errno) << endl << endl;
+				return false;
+			}
+			DEV_STATUS = " Editing " + DEV_MAP + ": save it to reload";
+		}
+		else if (currentParam == "--trace") // trace event JSON for chrome://tracing or Perfetto
+		{
+			if (i + 1 >= params.size()) {
+				endwin();
+				cout << "\n--trace needs a file name." << endl << endl;
+				return false;
+			}
+			startTrace(params[++i]);
+		}
+		else if (isFullDigits(currentParam)) // level select
 		{
 			int new_level = std::stoi(currentParam, nullptr, 0);
 			if (new_level > NUM_OF_LEVELS || new_level < 0) {
@@ -704,20 +757,64 @@ bool checkParams(int argc, char** argv) {
 		else
 		{
 			endwin();
-			cout << "\nInvalid arguments. Try ./pacvim or ./pacvim [#] [h/n]" <<
+			cout << "\nInvalid arguments. Try ./pacvim or ./pacvim [#] [h/n] [--practice] [--latency-report FILE] [--trace FILE] [--serve SOCKET] [--watch SOCKET] [--host NAME] [--join NAME] [--dev MAP]" <<
 				"\nEG: ./pacvim 8 n" << endl << endl;
 			return false;
 		}
 	}
+	if (mapWatcher.watching() && coop.hosting()) {
+		coop.stop();
+		mapWatcher.stop();
+		endwin();
+		cout << "\n--dev can't be combined with --host." << endl << endl;
+		return false;
+	}
+	if (PRACTICE_MODE && coop.hosting()) {
+		// rewinding would take the partner back in time too
+		coop.stop();
+		endwin();
+		cout << "\n--practice can't be combined with --host." << endl << endl;
+		return false;
+	}
 
 	return true;
 }
 
 int main(int argc, char** argv)
 {
+	// pacvim --lint maps/*.txt checks maps without starting the game
+	if (argc > 1 && string(argv[1]) == "--lint") {
+		return lintMaps(vector<string>(argv + 2, argv + argc));
+	}
+	// pacvim --tournament maps/*.txt lets scripted players play them
+	if (argc > 1 && string(argv[1]) == "--tournament") {
+		return runTournament(vector<string>(argv + 2, argv + argc));
+	}
+	// pacvim --tune maps/*.txt adjusts how fast their ghosts are
+	if (argc > 1 && string(argv[1]) == "--tune") {
+		return runTune(vector<string>(argv + 2, argv + argc));
+	}
+	// pacvim --generate --seed N --size WxH prints a new level
+	if (argc > 1 && string(argv[1]) == "--generate") {
+		return runGenerate(vector<string>(argv + 2, argv + argc));
+	}
+	// pacvim --bot-fd IN,OUT lets another process play over pipes
+	if (argc > 1 && string(argv[1]) == "--bot-fd") {
+		return runBot(vector<string>(argv + 1, argv + argc));
+	}
+	// pacvim --bench-scan times the row scan kernels against each other
+	if (argc > 1 && string(argv[1]) == "--bench-scan") {
+		return runScanBench(vector<string>(argv + 2, argv + argc));
+	}
+
 	// Setup
+	// curses writes UTF-8 if the terminal's locale says so; only the
+	// character type, so that numbers keep their decimal point
+	setlocale(LC_CTYPE, "");
 	WINDOW* win = initscr();
 	nodelay(win, TRUE);
+	keypad(win, TRUE); // F2 and friends come as single keys
+	set_escdelay(25);
 	defineColors();
 	noecho(); // dont print anything to the screen
 
@@ -731,6 +828,27 @@ int main(int argc, char** argv)
 		// program called with invalid arguments
 		return 0;
 	}
+	if (!JOIN_NAME.empty()) {
+		int status = joinGame(JOIN_NAME);
+		endwin();
+		return status;
+	}
+	if (!WATCH_SOCKET.empty()) {
+		int status = watchGame(WATCH_SOCKET);
+		endwin();
+		return status;
+	}
+
+	if (mapWatcher.watching()) {
+		// --dev: no tutorial and no game over, just the map again and again
+		IN_TUTORIAL = false;
+		while (true) {
+			int lives = LIVES;
+			GAME_WON = 0;
+			init(DEV_MAP.c_str());
+			LIVES = lives;
+		}
+	}
 
   while(GAME_WON != 1) {
     // tutorial
@@ -741,6 +859,7 @@ int main(int argc, char** argv)
 	GAME_WON = 0;
   IN_TUTORIAL = false;
 
+	unsigned endless_seed = std::random_device()();
 	while(LIVES >= 0) {
 		string mapName = MAPS_LOCATION "/map";
 		
@@ -750,6 +869,12 @@ int main(int argc, char** argv)
 		
 		mapName += ss.str(); // add it to mapName
 		mapName += ".txt"; // must be .txt
+		if (CURRENT_LEVEL > NUM_OF_LEVELS) {
+			// endless mode: after the last map, made up levels that grow
+			int generated = CURRENT_LEVEL - NUM_OF_LEVELS - 1;
+			mapName = generatedLevelName(endless_seed + generated, std::min(40 + 4 * generated, 80),
+			                             std::min(15 + 2 * generated, 25));
+		}
 		init(mapName.c_str());
 		if(GAME_WON == -1) {
 			CURRENT_LEVEL--;
@@ -763,19 +888,21 @@ int main(int argc, char** argv)
 			else if ((CURRENT_LEVEL % 3) == 0) {
 				LIVES++; // gain a life every 3 levels
 			}
+			if (CURRENT_LEVEL > NUM_OF_LEVELS) {
+				THINK_MULTIPLIER *= 0.95; // and the ghosts get faster
+			}
 				
 			GAME_WON = 0;
 			TOTAL_POINTS = 0;
 		}
 		CURRENT_LEVEL++;
-		// Start from beginning now
-		if(CURRENT_LEVEL > NUM_OF_LEVELS) {
-			CURRENT_LEVEL = 0;
-			THINK_MULTIPLIER *= 0.8;
-		}
 	}	
 	//endwin();
   std::this_thread::sleep_for(std::chrono::seconds(2));
 	endwin();
+	spectators.stop();
+	coop.stop();
+	writeLatencyReport();
+	writeTrace();
 	return 0;
 }          
@@ -0,0 +1,32 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef GAME_H
+#define GAME_H
+
+// What game.cpp does with a key, for code that plays without a keyboard
+// (see tournament.h).
+
+#include "keystroke.h"
+
+class avatar;
+
+void doKeystroke(avatar & unit, const Keystroke & keystroke);
+
+#endif
@@ -0,0 +1,361 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "generator.h"
+#include "lint.h"
+#include "mapFile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace {
+
+const int MIN_WIDTH = 9;
+const int MAX_WIDTH = 200;
+const int MIN_HEIGHT = 5;
+const int MAX_HEIGHT = 99; // the line numbers have two digits
+const int ROOM_WIDTH = 7; // characters per maze cell, its wall not counted
+const int MAX_ATTEMPTS = 100;
+const char * const GENERATED_PREFIX = "generated:";
+
+// what the corridors are filled with
+const char * const WORDS[] = {
+  "a", "I", "to", "be", "or", "not", "is", "the", "of", "and", "in", "my", "it",
+  "yank", "put", "undo", "redo", "word", "line", "mark", "jump", "find", "till",
+  "search", "buffer", "window", "insert", "normal", "visual", "escape", "motion",
+  "count", "macro", "register", "column", "cursor", "delete", "change", "join",
+  "ghost", "maze", "point", "tilde", "level", "lives", "wall", "green", "quit",
+  "question", "slings", "arrows", "fortune", "sea", "troubles", "sleep", "dream",
+  "rub", "mortal", "coil", "pause", "respect", "time", "whips", "scorns", "proud",
+  "tomorrow", "creeps", "petty", "pace", "day", "syllable", "recorded", "fools",
+  "dusty", "death", "brief", "candle", "walking", "shadow", "player", "struts",
+  "frets", "hour", "stage", "heard", "tale", "told", "idiot", "sound", "fury",
+};
+const int WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+const int dx[] = {0, 1, 0, -1};
+const int dy[] = {-1, 0, 1, 0};
+
+struct Spot {
+  int x, y;
+};
+
+class MazeBuilder {
+  int width, height;
+  std::minstd_rand & rng;
+  std::vector<std::string> rows;
+  int columns, cell_rows;
+  std::vector<int> room_x; // where room c starts; its wall is at room_x[c + 1] - 1
+
+  int random(int low, int high) { // both included
+    return std::uniform_int_distribution<int>(low, high)(rng);
+  }
+
+  bool open(int x, int y) const {
+    return x >= 0 && y >= 0 && x < width && y < height && rows[y][x] != '#' && rows[y][x] != '~';
+  }
+
+  // knock down the wall between cell (c, r) and its neighbour in direction d
+  void connect(int c, int r, int d) {
+    int y = 2 * r + 1;
+    if (dx[d] == 1) {
+      rows[y][room_x[c + 1] - 1] = ' ';
+    } else if (dy[d] == 1) {
+      int left = room_x[c], right = room_x[c + 1] - 2;
+      int length = random(1, right - left + 1);
+      int start = random(left, right - length + 1);
+      std::fill(rows[y + 1].begin() + start, rows[y + 1].begin() + start + length, ' ');
+    }
+  }
+
+  // a depth first maze over the cells, then some extra openings so that
+  // there are loops to run around ghosts in
+  void carve() {
+    for (int r = 0; r < cell_rows; ++r) {
+      for (int c = 0; c < columns; ++c) {
+        std::fill(rows[2 * r + 1].begin() + room_x[c], rows[2 * r + 1].begin() + room_x[c + 1] - 1, ' ');
+      }
+    }
+    std::vector<char> seen(columns * cell_rows, 0);
+    std::vector<int> stack{0};
+    seen[0] = 1;
+    while (!stack.empty()) {
+      int cell = stack.back();
+      int c = cell % columns, r = cell / columns;
+      int options[4], count = 0;
+      for (int d = 0; d < 4; ++d) {
+        int nc = c + dx[d], nr = r + dy[d];
+        if (nc >= 0 && nr >= 0 && nc < columns && nr < cell_rows && !seen[nr * columns + nc]) {
+          options[count++] = d;
+        }
+      }
+      if (count == 0) {
+        stack.pop_back();
+        continue;
+      }
+      int d = options[random(0, count - 1)];
+      int next = (r + dy[d]) * columns + c + dx[d];
+      // connect always knocks down the wall right of or below a cell
+      if (dx[d] == -1 || dy[d] == -1) {
+        connect(c + dx[d], r + dy[d], (d + 2) % 4);
+      } else {
+        connect(c, r, d);
+      }
+      seen[next] = 1;
+      stack.push_back(next);
+    }
+    for (int r = 0; r < cell_rows; ++r) {
+      for (int c = 0; c < columns; ++c) {
+        if (c + 1 < columns && random(0, 5) == 0) {
+          connect(c, r, 1);
+        }
+        if (r + 1 < cell_rows && random(0, 5) == 0) {
+          connect(c, r, 2);
+        }
+      }
+    }
+  }
+
+  // words, a space apart, along every stretch of corridor
+  void fillWords() {
+    for (int y = 1; y + 1 < height; ++y) {
+      for (int x = 1; x + 1 < width;) {
+        if (rows[y][x] == '#') {
+          ++x;
+          continue;
+        }
+        int end = x;
+        while (rows[y][end] != '#') {
+          ++end;
+        }
+        while (x < end) {
+          const char * word = nullptr;
+          for (int tries = 0; tries < 8 && !word; ++tries) {
+            const char * candidate = WORDS[random(0, WORD_COUNT - 1)];
+            if (static_cast<int>(strlen(candidate)) <= end - x) {
+              word = candidate;
+            }
+          }
+          if (!word) {
+            break;
+          }
+          for (const char * c = word; *c; ++c) {
+            rows[y][x++] = *c;
+          }
+          x += random(1, 2); // the spaces between words
+        }
+        x = end;
+      }
+    }
+  }
+
+  // how many steps every cell is from x, y; -1 where it can't be walked to
+  std::vector<int> distances(int x, int y) const {
+    std::vector<int> distance(width * height, -1);
+    std::vector<int> todo{y * width + x};
+    distance[y * width + x] = 0;
+    for (size_t next = 0; next < todo.size(); ++next) {
+      int cx = todo[next] % width, cy = todo[next] / width;
+      for (int d = 0; d < 4; ++d) {
+        int nx = cx + dx[d], ny = cy + dy[d];
+        if (open(nx, ny) && distance[ny * width + nx] == -1) {
+          distance[ny * width + nx] = distance[todo[next]] + 1;
+          todo.push_back(ny * width + nx);
+        }
+      }
+    }
+    return distance;
+  }
+
+  // whether a ~ on x, y leaves its open neighbours connected around it, in
+  // which case it can't cut the maze in two
+  bool trapKeepsMazeConnected(int x, int y) const {
+    static const int ring_x[] = {-1, 0, 1, 1, 1, 0, -1, -1};
+    static const int ring_y[] = {-1, -1, -1, 0, 1, 1, 1, 0};
+    // walk around the ring; the open sides must all be in one run of open
+    // cells (a run of corners alone doesn't touch x, y)
+    int start = 0;
+    while (start < 8 && open(x + ring_x[start], y + ring_y[start])) {
+      ++start;
+    }
+    if (start == 8) {
+      return true; // open all around
+    }
+    int runs_with_sides = 0;
+    bool in_run = false, run_has_side = false;
+    for (int k = 1; k <= 8; ++k) {
+      int i = (start + k) % 8;
+      bool here = open(x + ring_x[i], y + ring_y[i]);
+      if (here) {
+        in_run = true;
+        run_has_side |= i % 2 == 1;
+      } else if (in_run) {
+        runs_with_sides += run_has_side ? 1 : 0;
+        in_run = run_has_side = false;
+      }
+    }
+    return runs_with_sides == 1;
+  }
+
+public:
+  MazeBuilder(int w, int h, std::minstd_rand & r)
+    : width(w), height(h), rng(r), rows(h, std::string(w, '#')) {
+    columns = std::max(1, (width - 1) / (ROOM_WIDTH + 1));
+    cell_rows = (height - 1) / 2;
+    for (int c = 0; c <= columns; ++c) {
+      room_x.push_back(1 + c * (width - 1) / columns);
+    }
+  }
+
+  std::string build() {
+    carve();
+    fillWords();
+
+    std::vector<Spot> cells;
+    for (int y = 1; y + 1 < height; ++y) {
+      for (int x = 1; x + 1 < width; ++x) {
+        if (open(x, y)) {
+          cells.push_back({x, y});
+        }
+      }
+    }
+    Spot player = cells[random(0, cells.size() - 1)];
+    std::vector<int> distance = distances(player.x, player.y);
+    int farthest = *std::max_element(distance.begin(), distance.end());
+
+    // ghosts start in the far half of the maze
+    std::vector<Spot> far;
+    for (const Spot & s : cells) {
+      if (distance[s.y * width + s.x] * 2 >= farthest && distance[s.y * width + s.x] > 0) {
+        far.push_back(s);
+      }
+    }
+    std::shuffle(far.begin(), far.end(), rng);
+    far.resize(std::min<size_t>(far.size(), std::max<size_t>(1, cells.size() / 200)));
+    std::ostringstream ghost_lines;
+    for (const Spot & ghost : far) {
+      int think = random(60, 100);
+      ghost_lines << (random(0, 3) == 0 ? 'r' : '/')
+                  << (think == 100 ? "1" : "." + std::to_string(think)) << " "
+                  << ghost.x << " " << ghost.y << "\n";
+    }
+
+    // ~ traps, away from the player and never on a ghost
+    std::shuffle(cells.begin(), cells.end(), rng);
+    size_t traps = cells.size() / 50;
+    for (const Spot & s : cells) {
+      if (traps == 0) {
+        break;
+      }
+      bool on_ghost = std::any_of(far.begin(), far.end(), [&](const Spot & g) {
+        return g.x == s.x && g.y == s.y;
+      });
+      if (distance[s.y * width + s.x] > 2 && !on_ghost && trapKeepsMazeConnected(s.x, s.y)) {
+        rows[s.y][s.x] = '~';
+        --traps;
+      }
+    }
+
+    std::string text;
+    for (const std::string & row : rows) {
+      text += row + "\n";
+    }
+    return text + ghost_lines.str() + "p" + std::to_string(player.x) + " " + std::to_string(player.y) + "\n";
+  }
+};
+
+bool parseSize(const std::string & text, int & width, int & height) {
+  char x;
+  std::istringstream in(text);
+  return (in >> width >> x >> height) && x == 'x' && in.eof()
+      && width >= MIN_WIDTH && width <= MAX_WIDTH && height >= MIN_HEIGHT && height <= MAX_HEIGHT;
+}
+
+} // namespace
+
+bool generateMap(unsigned seed, int width, int height, std::string & text) {
+  if (width < MIN_WIDTH || width > MAX_WIDTH || height < MIN_HEIGHT || height > MAX_HEIGHT) {
+    return false;
+  }
+  for (unsigned attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+    std::seed_seq seeds{seed, attempt};
+    std::minstd_rand rng(seeds);
+    std::string candidate = MazeBuilder(width, height, rng).build();
+    MapFile map;
+    std::istringstream in(candidate);
+    parseMapFile(in, map);
+    if (lintMap("generated", map).empty()) {
+      text = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string generatedLevelName(unsigned seed, int width, int height) {
+  return GENERATED_PREFIX + std::to_string(seed) + ":" + std::to_string(width) + "x" + std::to_string(height);
+}
+
+bool parseGeneratedLevelName(const std::string & name, unsigned & seed, int & width, int & height) {
+  std::string prefix = GENERATED_PREFIX;
+  if (name.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  size_t colon = name.find(':', prefix.size());
+  if (colon == std::string::npos) {
+    return false;
+  }
+  char * end = nullptr;
+  std::string number = name.substr(prefix.size(), colon - prefix.size());
+  seed = strtoul(number.c_str(), &end, 10);
+  return !number.empty() && *end == '\0' && parseSize(name.substr(colon + 1), width, height);
+}
+
+int runGenerate(const std::vector<std::string> & args) {
+  unsigned seed = std::random_device()();
+  int width = 40, height = 15;
+  bool ok = true;
+  for (size_t i = 0; i < args.size() && ok; ++i) {
+    bool has_value = i + 1 < args.size();
+    char * end = nullptr;
+    if (args[i] == "--seed" && has_value) {
+      seed = strtoul(args[++i].c_str(), &end, 10);
+      ok = *end == '\0';
+    } else {
+      ok = args[i] == "--size" && has_value && parseSize(args[++i], width, height);
+    }
+  }
+  if (!ok) {
+    std::cerr << "Usage: pacvim --generate [--seed N] [--size WxH]\n"
+              << "       W from " << MIN_WIDTH << " to " << MAX_WIDTH << ", H from " << MIN_HEIGHT
+              << " to " << MAX_HEIGHT << std::endl;
+    return 2;
+  }
+  std::string text;
+  if (!generateMap(seed, width, height, text)) {
+    std::cerr << "no valid " << width << "x" << height << " level found for seed " << seed << std::endl;
+    return 1;
+  }
+  std::cout << text;
+  return 0;
+}
@@ -0,0 +1,48 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+// Levels made up on the spot: a maze of walls with words in its corridors,
+// some ~ traps, ghosts and a player start, written in the map file format.
+// Every level is checked with lintMap before it is handed out, so all of
+// its points can be reached and its first walkable line is line 2; a
+// candidate that fails is thrown away and the next one tried.
+//
+//   pacvim --generate [--seed N] [--size WxH]
+//
+// prints a level; the same seed and size always give the same level.
+// loadLevel also takes generatedLevelName(...) instead of a file name, which
+// is how the game goes on after the last map (endless mode).
+
+#include <string>
+#include <vector>
+
+// map text, ghost and player lines; false if no valid level was found
+bool generateMap(unsigned seed, int width, int height, std::string & text);
+
+// the name loadLevel knows a generated level by, and back
+std::string generatedLevelName(unsigned seed, int width, int height);
+bool parseGeneratedLevelName(const std::string & name, unsigned & seed, int & width, int & height);
+
+// returns the exit code
+int runGenerate(const std::vector<std::string> & args);
+
+#endif
@@ -19,77 +19,166 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "ghost1.h"
-#include <random>
+#include "threadPool.h"
+#include "trace.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
 
-double Ghost1::eval(int positionX, int positionY, int playerX, int playerY, bool ignoreWalls) {
-	if(!isValid(positionX,positionY,ignoreWalls))
-		return 1000;
-	return sqrt(pow(playerY-positionY, 2.0) + pow(playerX-positionX, 2.0));
+static size_t species_index(Ghost_Species species) {
+  return static_cast<size_t>(species);
 }
 
-void Ghost1::think() {
-	if(GAME_WON != 0) {
-	  return;
-	}
-	if (FREEZE_GHOSTS != 0) {
-	  return;
-	}
+// shared by all species; they plan one after the other
+static ThreadPool & thinkPool() {
+  static ThreadPool pool(GHOST_THREADS);
+  return pool;
+}
 
-  auto now = std::chrono::steady_clock::now();
-  std::chrono::duration<double> elapsed_seconds = now - last_think_time;
-	if (elapsed_seconds.count() < sleepTime) {
-	    return;
-	}
-	last_think_time = now;
-
-	switch (species) {
-	  case Ghost_Species::Seeker:
-	    seeker_think();
-	    break;
-	  case Ghost_Species::Lemming:
-	  case Ghost_Species::Clockwise_Lemming:
-	  case Ghost_Species::AntiClockwise_Lemming:
-	    lemming_think();
-	    break;
-	  case Ghost_Species::Agent_Smith:
-	    smith_think();
-	    break;
-	  default:
-	    writeError("Invalid species!");
-	}
+void Ghosts::clear() {
+  for (size_t i = 0; i < size(); ++i) {
+    board.remove(entity(i));
+  }
+  x.clear();
+  y.clear();
+  think_time.clear();
+  next_think.clear();
+  direction.clear();
+  moving.clear();
+  awake.clear();
+  rng.clear();
+  std::fill(species_begin, species_begin + SPECIES_COUNT + 1, 0);
+}
+
+void Ghosts::spawn(const GhostSpawn * spawns, size_t count, double think_multiplier, double now,
+                   unsigned seed) {
+  clear();
+  std::vector<GhostSpawn> sorted(spawns, spawns + count);
+  std::stable_sort(sorted.begin(), sorted.end(), [](const GhostSpawn & a, const GhostSpawn & b) {
+    return species_index(a.species) < species_index(b.species);
+  });
+  std::random_device rd;
+  for (const GhostSpawn & spawn : sorted) {
+    ++species_begin[species_index(spawn.species) + 1];
+    x.push_back(spawn.x);
+    y.push_back(spawn.y);
+    think_time.push_back(think_multiplier * spawn.think);
+    next_think.push_back(now + think_multiplier * spawn.think);
+    direction.push_back(Direction::North);
+    moving.push_back(0);
+    awake.push_back(0);
+    if (seed == RANDOM_SEED) {
+      rng.push_back(std::minstd_rand(rd()));
+    } else {
+      std::seed_seq ghost_seed{seed, static_cast<unsigned>(rng.size())};
+      rng.push_back(std::minstd_rand(ghost_seed));
+    }
+  }
+  // counts to start indexes
+  for (int s = 0; s < SPECIES_COUNT; ++s) {
+    species_begin[s + 1] += species_begin[s];
+  }
+  // Agent Smith stays off the board until it shows itself
+  for (size_t i = 0; i < species_begin[species_index(Ghost_Species::Agent_Smith)]; ++i) {
+    board.place(entity(i), x[i], y[i]);
+  }
+  // whatever update needs, so that it doesn't allocate while playing
+  board.reserveEntities(FIRST_GHOST_ENTITY + size());
+  due.reserve(size());
+  moves.reserve(size());
+  claims.reserve(size());
+  ready.reserve(size());
+  thinkPool();
+}
+
+GhostState Ghosts::state(size_t i) const {
+  GhostState s;
+  s.x = x[i];
+  s.y = y[i];
+  s.direction = direction[i];
+  s.moving = moving[i];
+  s.awake = awake[i];
+  s.rng = rng[i];
+  return s;
 }
 
-void Ghost1::seeker_think() {
-  bool ignoreWalls = can_ignore_walls ? rare_ability(50) : false;
+void Ghosts::restore(size_t i, const GhostState & s, double now) {
+  x[i] = s.x;
+  y[i] = s.y;
+  direction[i] = s.direction;
+  moving[i] = s.moving;
+  awake[i] = s.awake;
+  rng[i] = s.rng;
+  next_think[i] = now + think_time[i];
+  bool hidden = i >= species_begin[species_index(Ghost_Species::Agent_Smith)] && !awake[i];
+  if (hidden) {
+    board.remove(entity(i));
+  } else {
+    board.place(entity(i), x[i], y[i]);
+  }
+}
 
+// the player closest to gx, gy; with a partner playing (--host) ghosts go
+// after whoever is nearest. Stays -1, -1 if nobody is on the board.
+static void nearestPlayer(int gx, int gy, int & playerX, int & playerY) {
+  int best = -1;
+  for (EntityId id : {PLAYER_ENTITY, PARTNER_ENTITY}) {
+    int px, py;
+    if (board.position(id, px, py)) {
+      int distance = (px - gx) * (px - gx) + (py - gy) * (py - gy);
+      if (best == -1 || distance < best) {
+        best = distance;
+        playerX = px;
+        playerY = py;
+      }
+    }
+  }
+}
+
+double Ghosts::eval(int positionX, int positionY, int playerX, int playerY, bool ignoreWalls) {
+	if(!board.isValid(positionX,positionY,ignoreWalls))
+		return 1000;
+	return sqrt(pow(playerY-positionY, 2.0) + pow(playerX-positionX, 2.0));
+}
+
+GhostMove Ghosts::seeker_think(size_t i, bool ignoreWalls) {
 	// evaluate the four potential paths and move accordingly
-	int playerX, playerY;
-	getyx(stdscr, playerY, playerX);
+	int gx = x[i], gy = y[i];
+	int playerX = -1, playerY = -1;
+	nearestPlayer(gx, gy, playerX, playerY);
 
-	double up = eval(x, y-1, playerX, playerY, ignoreWalls);
-	double down = eval(x, y+1, playerX, playerY, ignoreWalls);
-	double left = eval(x-1, y, playerX, playerY, ignoreWalls);
-	double right = eval(x+1, y, playerX, playerY, ignoreWalls);
+	double up = eval(gx, gy-1, playerX, playerY, ignoreWalls);
+	double down = eval(gx, gy+1, playerX, playerY, ignoreWalls);
+	double left = eval(gx-1, gy, playerX, playerY, ignoreWalls);
+	double right = eval(gx+1, gy, playerX, playerY, ignoreWalls);
 
+	GhostMove move;
+	move.wants_move = true;
+	move.ignore_walls = ignoreWalls;
+	move.x = gx;
+	move.y = gy;
 	if(up <= down && up <= left && up <= right) {
-		moveTo(x, y-1, ignoreWalls);
+		move.y = gy-1;
 	} else if(down <= left && down <= right && down <= up) {
-		moveTo(x, y+1, ignoreWalls);
+		move.y = gy+1;
 	} else if(left <= right && left <= up && left <= down) {
-		moveTo(x-1, y, ignoreWalls);
+		move.x = gx-1;
 	} else if(right <= up && right <= down && right <= left) {
-		moveTo(x+1, y, ignoreWalls);
+		move.x = gx+1;
+	} else {
+		move.wants_move = false;
 	}
+	return move;
 }
 
-Direction Ghost1::get_most_pronounced_direction() {
+Direction Ghosts::get_most_pronounced_direction(size_t i) {
   int vertical_middle = (MAP_END - MAP_BEGIN) / 2;
   int horizontal_middle = WIDTH / 2;
 
-  int northness = vertical_middle - y;
-  int southness = y - vertical_middle;
-  int eastness = x - horizontal_middle;
-  int westness = horizontal_middle - x;
+  int northness = vertical_middle - y[i];
+  int southness = y[i] - vertical_middle;
+  int eastness = x[i] - horizontal_middle;
+  int westness = horizontal_middle - x[i];
 
   if (northness > southness && northness > eastness && northness > westness) {
     return Direction::North;
@@ -107,179 +196,254 @@ Direction Ghost1::get_most_pronounced_direction() {
   return Direction::North;
 }
 
-Direction Ghost1::get_next_dir(Direction previous_dir) {
-  bool clockwise = species == Ghost_Species::Clockwise_Lemming;
+static Direction get_next_dir(Direction previous_dir, bool clockwise) {
   switch (previous_dir) {
     case Direction::North:
-      if (clockwise) {
-        return Direction::East;
-      } else {
-        return Direction::West;
-      }
+      return clockwise ? Direction::East : Direction::West;
     case Direction::East:
-        if (clockwise) {
-          return Direction::South;
-        } else {
-          return Direction::North;
-        }
-      case Direction::South:
-        if (clockwise) {
-          return Direction::West;
-        } else {
-          return Direction::East;
-        }
-      case Direction::West:
-        if (clockwise) {
-          return Direction::North;
-        } else {
-          return Direction::South;
-        }
-      default:
-        writeError("Invalid direction!");
-        return previous_dir;
+      return clockwise ? Direction::South : Direction::North;
+    case Direction::South:
+      return clockwise ? Direction::West : Direction::East;
+    case Direction::West:
+      return clockwise ? Direction::North : Direction::South;
+    default:
+      writeError("Invalid direction!");
+      return previous_dir;
   }
 }
 
-bool Ghost1::ghost_at_position(int x, int y) {
-	chtype curChar = charAt(x, y);
-  return PAIR_NUMBER(curChar & A_COLOR) == 1;
+struct offset { int x, y; };
+
+static const offset OFFSETS[] = {
+  {0, -1}, // North
+  {1, 0},  // East
+  {0, 1},  // South
+  {-1, 0}, // West
+};
+
+static offset offset_of(Direction dir) {
+  return OFFSETS[static_cast<int>(dir)];
 }
 
-bool Ghost1::direction_valid(Direction dir) {
-  switch(dir) {
-    case Direction::North:
-      return isValid(x, y-1) && !ghost_at_position(x, y-1);
-    case Direction::East:
-      return isValid(x+1, y) && !ghost_at_position(x+1, y);
-    case Direction::South:
-      return isValid(x, y+1) && !ghost_at_position(x, y+1);
-    case Direction::West:
-      return isValid(x-1, y) && !ghost_at_position(x-1, y);
-    default:
-      writeError("Invalid direction when checking for walls");
-      return false;
-  }
+bool Ghosts::direction_valid(size_t i, Direction dir) {
+  offset o = offset_of(dir);
+  return board.isValid(x[i] + o.x, y[i] + o.y) && !board.ghostAt(x[i] + o.x, y[i] + o.y);
 }
 
-bool Ghost1::rare_ability(int rarity) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
+bool Ghosts::rare_ability(size_t i, int rarity) {
   std::uniform_int_distribution<> dist(0, rarity);
-  int pick_random = dist(gen);
+  int pick_random = dist(rng[i]);
   return pick_random == 0;
 }
 
-Direction Ghost1::get_next_valid_dir(Direction direction) {
-  int directions_tried = 0;
-  for(int directions_tried = 0; !direction_valid(direction); direction = get_next_dir(direction), ++directions_tried) {
+Direction Ghosts::get_next_valid_dir(size_t i, Direction dir, bool clockwise) {
+  for(int directions_tried = 0; !direction_valid(i, dir); dir = get_next_dir(dir, clockwise), ++directions_tried) {
     // intentionally empty, except for error that shouldn't ever occur
     if (directions_tried > 4) { // maybe this should be 3 but I don't care right now
       writeError("(Anti)Clockwise lemming is going around in circles! (could be a map error)");
       return Direction::North;
     }
   }
-  if (direction == current_direction) {
-    if (rare_ability(200)) {
+  if (dir == direction[i]) {
+    if (rare_ability(i, 200)) {
       // very rarely change direction when not hitting wall
-      return get_next_valid_dir(get_next_dir(direction));
+      return get_next_valid_dir(i, get_next_dir(dir, clockwise), clockwise);
     }
   }
-  return direction;
+  return dir;
 }
 
-void Ghost1::smith_think() {
-  int playerX = player.getX();
-  int playerY = player.getY();
-  float distance = sqrt( (x - playerX) * (x - playerX) +
-                         (y - playerY) * (y - playerY) );
-  std::stringstream ss;
-  if (distance < 4.1 and distance >= 0.1) {
-    species = Ghost_Species::Seeker;
-    spawn(x, y);
+bool Ghosts::pick_random_direction(size_t i) {
+  Direction valid_dirs[4];
+  int valid_count = 0;
+  const Direction order[] = { Direction::North, Direction::South, Direction::West, Direction::East };
+  for (Direction dir : order) {
+    offset o = offset_of(dir);
+    if (board.isValid(x[i] + o.x, y[i] + o.y)) {
+      valid_dirs[valid_count++] = dir;
+    }
   }
+  if (valid_count == 0) {
+    writeError("Lemming has no place to go!");
+    return false;
+  }
+  std::uniform_int_distribution<> dist(0, valid_count - 1);
+  direction[i] = valid_dirs[dist(rng[i])];
+  return true;
 }
 
-void Ghost1::lemming_think() {
-  lemming_pickdir();
-  moveTo(x + previous_xoffset, y + previous_yoffset);
-}
-
-void Ghost1::lemming_pickdir() {
-  if (previous_xoffset == 0 && previous_yoffset == 0) {
+template <Ghost_Species species>
+GhostMove Ghosts::lemming_think(size_t i) {
+  const bool clockwise = species == Ghost_Species::Clockwise_Lemming;
+  if (!moving[i]) {
     if (species == Ghost_Species::Lemming) {
-      pick_random_direction();
+      moving[i] = pick_random_direction(i);
     } else {
-      Direction current_area = get_most_pronounced_direction();
-      writeError("Most pronounced dir:");
-      writeError(std::to_string(static_cast<int>(current_area)));
-      Direction turned_dir = get_next_dir(current_area); // do one turn for sure,
-      Direction next_dir = get_next_valid_dir(turned_dir); // then as many as necessary
-      pick_direction(next_dir);
+      Direction current_area = get_most_pronounced_direction(i);
+      Direction turned_dir = get_next_dir(current_area, clockwise); // do one turn for sure,
+      direction[i] = get_next_valid_dir(i, turned_dir, clockwise); // then as many as necessary
+      moving[i] = 1;
     }
-    return;
+  } else {
+    direction[i] = get_next_valid_dir(i, direction[i], clockwise);
   }
-  Direction next_dir = get_next_valid_dir(current_direction);
-  pick_direction(next_dir);
+  GhostMove move;
+  offset o = offset_of(direction[i]);
+  move.wants_move = moving[i];
+  move.x = x[i] + o.x;
+  move.y = y[i] + o.y;
+  return move;
 }
 
-void Ghost1::spawn(int theX, int theY) {
-  if (species == Ghost_Species::Agent_Smith) {
-    x = theX;
-    y = theY;
-	  letterUnder = charAt(x, y);
-    can_ignore_walls = true;
-  } else {
-    avatar::spawn(theX, theY);
+GhostMove Ghosts::smith_think(size_t i) {
+  if (awake[i]) {
+    // once shown, Agent Smith seeks, now and then straight through a wall
+    return seeker_think(i, rare_ability(i, 50));
+  }
+  int playerX = -1, playerY = -1;
+  nearestPlayer(x[i], y[i], playerX, playerY);
+  float distance = sqrt( (x[i] - playerX) * (x[i] - playerX) +
+                         (y[i] - playerY) * (y[i] - playerY) );
+  GhostMove move;
+  if (distance < 4.1 and distance >= 0.1) {
+    move.morph = true;
   }
-  last_think_time = std::chrono::steady_clock::now();
+  return move;
 }
 
-void Ghost1::pick_direction(Direction dir) {
-    current_direction = dir;
-    switch(dir) {
-      case Direction::North:
-        previous_xoffset = 0;
-        previous_yoffset = -1;
-        return;
-      case Direction::East:
-        previous_xoffset = 1;
-        previous_yoffset = 0;
-        return;
-      case Direction::South:
-        previous_xoffset = 0;
-        previous_yoffset = 1;
-        return;
-      case Direction::West:
-        previous_xoffset = -1;
-        previous_yoffset = 0;
-        return;
+template <Ghost_Species species>
+void Ghosts::plan_species(double now) {
+  size_t begin = species_begin[species_index(species)];
+  size_t end = species_begin[species_index(species) + 1];
+  size_t first_due = due.size();
+  for (size_t i = begin; i < end; ++i) {
+    if (next_think[i] <= now) {
+      next_think[i] = now + think_time[i];
+      due.push_back(i);
     }
+  }
+  size_t due_count = due.size() - first_due;
+  moves.resize(due.size());
+  static const char * think_names[SPECIES_COUNT] = {
+    "seeker think", "lemming think", "clockwise lemming think",
+    "anticlockwise lemming think", "agent smith think"
+  };
+  thinkPool().parallel_for(due_count, [&](size_t k) {
+    TRACE_SPAN(think_names[species_index(species)]);
+    size_t i = due[first_due + k];
+    switch (species) {
+      case Ghost_Species::Seeker:
+        moves[first_due + k] = seeker_think(i, false);
+        break;
+      case Ghost_Species::Lemming:
+      case Ghost_Species::Clockwise_Lemming:
+      case Ghost_Species::AntiClockwise_Lemming:
+        moves[first_due + k] = lemming_think<species>(i);
+        break;
+      case Ghost_Species::Agent_Smith:
+        moves[first_due + k] = smith_think(i);
+        break;
+    }
+  }, 64);
 }
 
-void Ghost1::pick_random_direction() {
-  std::vector<Direction> valid_dirs;
-  if (isValid(x, y-1)) {
-    valid_dirs.push_back(Direction::North);
+bool Ghosts::moveTo(size_t i, int a, int b, bool ignoreWalls) {
+  TRACE_SPAN("Ghosts::moveTo");
+  if (GAME_WON == 1) {
+    return false;
   }
-  if (isValid(x, y+1)) {
-    valid_dirs.push_back(Direction::South);
+	if(!board.isValid(a, b, ignoreWalls)) {
+		return false;
+	}
+	// see if we stepped on the player, who may be on the left half of a
+	// wide character
+	if(board.playerAt(a, b) || (board.letter(a, b) == WIDE_TAIL && board.playerAt(a - 1, b))) {
+		GAME_WON = -1; // hit the player, end the game
+		DEATH_CAUSE = Death::Ghost;
+	}
+	// check if we are hitting a ghost-- if so, it's an invalid location
+	else if (board.entityAt(a, b) != NO_ENTITY && board.entityAt(a, b) != entity(i)) {
+		return false;
+	}
+	x[i] = a;
+	y[i] = b;
+	board.place(entity(i), a, b);
+	return true;
+}
+
+void Ghosts::update(double now) {
+  TRACE_SPAN("Ghosts::update");
+	if(GAME_WON != 0) {
+	  return;
+	}
+	if (FREEZE_GHOSTS != 0) {
+	  return;
+	}
+
+  // phase 1: everybody plans against the same board, which nothing
+  // changes until all plans are in. The switch in plan_species is on a
+  // template argument, so every species gets its own think loop.
+  due.clear();
+  moves.clear();
+  plan_species<Ghost_Species::Seeker>(now);
+  plan_species<Ghost_Species::Lemming>(now);
+  plan_species<Ghost_Species::Clockwise_Lemming>(now);
+  plan_species<Ghost_Species::AntiClockwise_Lemming>(now);
+  plan_species<Ghost_Species::Agent_Smith>(now);
+  if (due.empty()) {
+    return;
   }
-  if (isValid(x-1, y)) {
-    valid_dirs.push_back(Direction::West);
+
+  // phase 2: apply the moves. Agent Smiths appear first; then a ghost may
+  // move once its target is free. When several want the same cell, the one
+  // standing on the lowest cell gets it: ghosts never share a cell, so that
+  // doesn't depend on the order they are stored in. A ghost leaving a cell
+  // lets the one waiting for it go next, so chains of ghosts all move;
+  // cycles stay put.
+  for (size_t k = 0; k < due.size(); ++k) {
+    if (moves[k].morph) {
+      size_t i = due[k];
+      awake[i] = 1;
+      next_think[i] = now + think_time[i];
+      moveTo(i, x[i], y[i], true);
+    }
   }
-  if (isValid(x+1, y)) {
-    valid_dirs.push_back(Direction::East);
+  auto cell_of = [&](int cx, int cy) { return cy * board.getWidth() + cx; };
+  // a move off the board (a seeker with nowhere to go, say) claims
+  // nothing: cell_of would make it some other cell, taken from a ghost that
+  // can move there
+  claims.clear();
+  for (size_t k = 0; k < due.size(); ++k) {
+    if (moves[k].wants_move && board.inside(moves[k].x, moves[k].y)) {
+      size_t i = due[k];
+      claims.push_back({cell_of(moves[k].x, moves[k].y), cell_of(x[i], y[i]), k});
+    }
   }
-  if (valid_dirs.empty()) {
-    writeError("Lemming has no place to go!");
-    previous_xoffset = 0;
-    previous_yoffset = 0;
-    return;
+  std::sort(claims.begin(), claims.end());
+  // the index into moves of the ghost that gets the cell, due.size() if none
+  auto claimant = [&](int cell) {
+    Claim first = {cell, INT_MIN, 0};
+    auto claim = std::lower_bound(claims.begin(), claims.end(), first);
+    return claim != claims.end() && claim->target == cell ? claim->move : due.size();
+  };
+  ready.clear();
+  for (size_t k = 0; k < due.size(); ++k) {
+    int target = cell_of(moves[k].x, moves[k].y);
+    if (moves[k].wants_move && claimant(target) == k && !board.ghostAt(moves[k].x, moves[k].y)) {
+      ready.push_back(k);
+    }
+  }
+  // a queue: every ghost is in it at most once, so it never outgrows due
+  for (size_t next = 0; next < ready.size(); ++next) {
+    size_t k = ready[next];
+    size_t i = due[k];
+    int from = cell_of(x[i], y[i]);
+    if (!moveTo(i, moves[k].x, moves[k].y, moves[k].ignore_walls)) {
+      continue;
+    }
+    size_t waiting = claimant(from);
+    if (waiting != due.size() && waiting != k) {
+      ready.push_back(waiting);
+    }
   }
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> dist(0, valid_dirs.size() - 1);
-  int random_index = dist(gen);
-  Direction random_dir = valid_dirs[random_index];
-  pick_direction(random_dir);
 }
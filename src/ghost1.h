@@ -21,9 +21,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef GHOST1_H
 #define GHOST1_H
 
-#include "avatar.h"
-#include <time.h>
-#include <map>
+#include "helperFns.h"
+#include <random>
+#include <vector>
 
 enum class Ghost_Species {
   Seeker, // goes towards the player
@@ -37,41 +37,106 @@ enum class Direction {
   North, East, South, West
 };
 
-struct offset {
+// a ghost line from the map file, already in screen coordinates
+struct GhostSpawn {
+  Ghost_Species species;
+  double think;
   int x;
   int y;
 };
 
-class Ghost1 : public avatar {
-	private:
-	  Ghost_Species species;
-		bool can_ignore_walls = false; // Agent Smith can do this (after morphing into seeker)
-    std::chrono::time_point<std::chrono::steady_clock> last_think_time;
-
-    // previous direction of travel for lemmings
-    Direction current_direction;
-    int previous_xoffset = 0;
-    int previous_yoffset = 0;
-
-		double sleepTime;
-    bool ghost_at_position(int x, int y);
-    bool direction_valid(Direction dir);
-    void pick_direction(Direction dir);
-    Direction get_most_pronounced_direction();
-    Direction get_next_dir(Direction previous_dir);
-    Direction get_next_valid_dir(Direction direction);
-    bool rare_ability(int rarity);
-    double eval(int positionX, int positionY, int playerX, int playerY, bool ignoreWalls);
-    void pick_random_direction();
-    void smith_think();
-    void seeker_think();
-    void lemming_think();
-    void lemming_pickdir();
-	public:
-		Ghost1(Ghost_Species s, double c) : species(s), avatar(false, 'G', COLOR_RED) {
-		  sleepTime = c;
-		}
-    virtual void spawn(int theX, int theY) override;
-		void think();
+const int SPECIES_COUNT = 5;
+
+// everything about one ghost that changes while playing, for rewinding
+struct GhostState {
+  short x = 0;
+  short y = 0;
+  Direction direction = Direction::North;
+  unsigned char moving = 0;
+  unsigned char awake = 0;
+  std::minstd_rand rng;
+
+  bool operator==(const GhostState & other) const {
+    return x == other.x && y == other.y && direction == other.direction
+        && moving == other.moving && awake == other.awake && rng == other.rng;
+  }
+  bool operator!=(const GhostState & other) const { return !(*this == other); }
+};
+
+// What a ghost decided to do this tick; applied later by update
+struct GhostMove {
+  bool wants_move = false;
+  int x = 0;
+  int y = 0;
+  bool ignore_walls = false;
+  bool morph = false; // Agent Smith showing itself
+};
+
+// All the ghosts of a level, stored as a structure of arrays. The ghosts are
+// sorted by species, so every species' think function runs over one dense
+// range of indexes. Ghost i is entity FIRST_GHOST_ENTITY + i on the board.
+class Ghosts {
+  std::vector<int> x;
+  std::vector<int> y;
+  std::vector<double> think_time; // seconds between moves
+  std::vector<double> next_think; // when the ghost moves next
+  std::vector<Direction> direction; // lemmings: direction of travel
+  std::vector<unsigned char> moving; // lemmings: has a direction yet
+  std::vector<unsigned char> awake; // Agent Smith: has shown itself
+  // every ghost has its own generator so they can plan in parallel
+  std::vector<std::minstd_rand> rng;
+  size_t species_begin[SPECIES_COUNT + 1] = {0};
+
+  // per tick scratch space, kept to avoid reallocating every tick
+  std::vector<size_t> due;
+  std::vector<GhostMove> moves;
+  // a bid for a cell; for every target the ghost on the lowest cell
+  // (as y * width + x) sorts first
+  struct Claim {
+    int target;
+    int from;
+    size_t move; // index into moves
+    bool operator<(const Claim & o) const {
+      return target != o.target ? target < o.target : from != o.from ? from < o.from : move < o.move;
+    }
+  };
+  std::vector<Claim> claims;
+  std::vector<size_t> ready; // indexes into moves, in the order they move
+
+  EntityId entity(size_t i) const { return FIRST_GHOST_ENTITY + i; }
+  bool rare_ability(size_t i, int rarity);
+  bool direction_valid(size_t i, Direction dir);
+  Direction get_most_pronounced_direction(size_t i);
+  Direction get_next_valid_dir(size_t i, Direction direction, bool clockwise);
+  bool pick_random_direction(size_t i);
+  double eval(int positionX, int positionY, int playerX, int playerY, bool ignoreWalls);
+  bool moveTo(size_t i, int a, int b, bool ignoreWalls);
+
+  // the per species think functions; they only look at the board and
+  // change nothing but ghost i's own state, so ghosts can plan in parallel
+  GhostMove seeker_think(size_t i, bool ignoreWalls);
+  template <Ghost_Species species> GhostMove lemming_think(size_t i);
+  GhostMove smith_think(size_t i);
+  template <Ghost_Species species> void plan_species(double now);
+
+public:
+  // replace all ghosts by spawns[0..count) and put them on the board; the
+  // same seed gives the same random choices (for --tournament)
+  static const unsigned RANDOM_SEED = 0;
+  void spawn(const GhostSpawn * spawns, size_t count, double think_multiplier, double now,
+             unsigned seed = RANDOM_SEED);
+  void clear();
+  size_t size() const { return x.size(); }
+  int getX(size_t i) const { return x[i]; }
+  int getY(size_t i) const { return y[i]; }
+  GhostState state(size_t i) const;
+  // put ghost i back in an earlier state; it moves next think_time after now
+  void restore(size_t i, const GhostState & s, double now);
+
+  // Let every ghost that is due move. All of them plan against the same
+  // state of the board first, in parallel; the moves are then applied in
+  // an order that depends on where the ghosts stand, not on the order in
+  // which they are stored or planned.
+  void update(double now);
 };
 #endif
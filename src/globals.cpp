@@ -18,20 +18,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "globals.h"
-#include "reachableMap.h"
+#include "avatar.h"
+#include "level.h"
 #include "ghost1.h"
+#include "rewind.h"
+#include "spectate.h"
+#include "coop.h"
+#include "mapWatcher.h"
 #include <string>
 #include <vector>
 
 int TOTAL_POINTS = 0;
 int GAME_WON = 0;
+Death DEATH_CAUSE = Death::None;
 int FREEZE_GHOSTS = 0;
-std::string INPUT = "";
+bool PRACTICE_MODE = false;
+bool SHOW_TIMINGS = false;
+KeyParser INPUT;
 bool READY = false;
 int LIVES = 3;
 const int NUM_OF_LEVELS = 17;
 
 double THINK_MULTIPLIER = 1.0;
+unsigned GHOST_THREADS = 0;
 
 int MAP_BEGIN = 0;
 int MAP_END = 0;
@@ -41,9 +50,17 @@ bool IN_TUTORIAL = true;
 
 bool lastJumpWasForwards;
 bool lastJumpIncludedTarget;
-char lastJumpChar = '\0';
+char32_t lastJumpChar = '\0';
 
-ReachableMap reachability_map;
-std::vector<Ghost1> ghosts;
+Level level;
+Board board;
+LatencyStats latency_stats;
+std::string LATENCY_REPORT_FILE;
+Ghosts ghosts;
+History history;
+SpectatorServer spectators;
+CoopHost coop;
+MapWatcher mapWatcher;
 
-avatar player (true, ' ', COLOR_WHITE);
+avatar player (true, ' ', COLOR_WHITE, PLAYER_ENTITY);
+avatar partner (true, ' ', COLOR_WHITE, PARTNER_ENTITY);
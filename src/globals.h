@@ -16,14 +16,7 @@ You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
  */
-#ifdef __APPLE__
-#include <curses.h>
-#elif __FreeBSD__
-#include <curses.h>
-#else
-#include <cstddef>
-#include <ncurses.h>
-#endif
+#include "terminal.h"
 
 
 
@@ -33,25 +26,45 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <set>
 #include <vector>
 #include <mutex>
-#include "reachableMap.h"
+#include "board.h"
+#include "keystroke.h"
+#include "latency.h"
 
 //#include <cursesw.h>
 extern int TOTAL_POINTS;
 extern int GAME_WON; // 0 = in progress, 1 = won, -1 = lose
+enum class Death { None, Ghost, Tilde };
+extern Death DEATH_CAUSE; // why GAME_WON went to -1
 extern int FREEZE_GHOSTS; // 0 = moving, 1 = frozen
-extern std::string INPUT; // keyboard characters
+extern bool PRACTICE_MODE; // --practice: u and Ctrl-R step through time
+extern bool SHOW_TIMINGS; // F2: frame timing overlay
+extern KeyParser INPUT; // the command being typed
 extern int CURRENT_LEVEL;
 extern bool IN_TUTORIAL;
-extern ReachableMap reachability_map;
-class Ghost1;
-extern std::vector<Ghost1> ghosts;
+struct Level;
+extern Level level; // the map being played, parsed and analysed
+extern Board board; // terrain, eaten cells and who stands where
+extern LatencyStats latency_stats; // keypress to screen, per motion type
+extern std::string LATENCY_REPORT_FILE; // --latency-report, empty for errors.log
+class Ghosts;
+extern Ghosts ghosts;
+class History;
+extern History history; // practice mode only
+class SpectatorServer;
+extern SpectatorServer spectators; // --serve
 class avatar;
 extern avatar player;
+extern avatar partner; // the second player of a --host game
+class CoopHost;
+extern CoopHost coop; // --host
+class MapWatcher;
+extern MapWatcher mapWatcher; // --dev
 extern int LIVES;
 extern const int NUM_OF_LEVELS;
 
 extern bool READY;
 extern double THINK_MULTIPLIER; // all the think times for the AI are multipled by this
+extern unsigned GHOST_THREADS; // threads planning ghost moves, 0 for one per core
 
 extern int MAP_BEGIN; // the first row in which a play can move in (near the *top* of the map file!)
 extern int MAP_END;   // the last row with any character on it at all (not necessarily inside the map)
@@ -60,7 +73,7 @@ extern int WIDTH;
 
 extern bool lastJumpWasForwards;
 extern bool lastJumpIncludedTarget;
-extern char lastJumpChar;
+extern char32_t lastJumpChar;
 
 #endif
 
@@ -0,0 +1,49 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "headless.h"
+#include "avatar.h"
+#include "doors.h"
+#include "ghost1.h"
+#include "level.h"
+
+bool startHeadlessLevel(const std::string & path, double think_multiplier, unsigned seed) {
+  if (level.path != path && !loadLevel(path, level)) {
+    return false;
+  }
+  WIDTH = level.width;
+  MAP_BEGIN = level.map_begin;
+  MAP_END = level.map_end;
+  TOTAL_POINTS = level.total_points;
+  board.loadTerrain(level.board_width, level.board_height, level.terrain.data());
+  resetDoors();
+  GAME_WON = 0;
+  DEATH_CAUSE = Death::None;
+  FREEZE_GHOSTS = 0;
+  lastJumpWasForwards = true;
+  lastJumpIncludedTarget = true;
+  lastJumpChar = '\0';
+  player.spawn(level.start_x, level.start_y);
+  ghosts.spawn(level.ghosts.data(), level.ghosts.size(), think_multiplier, 0.0, seed);
+  return true;
+}
+
+void headlessTick(long tick) {
+  ghosts.update(tick * TICK_SECONDS);
+}
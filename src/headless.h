@@ -0,0 +1,37 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Playing without a terminal, on a simulated clock, for scripted players
+// (tournament.h) and bots (bot.h). A tick is one frame of playGame: the
+// keys for it, then the ghosts.
+
+#include <string>
+
+const double TICK_SECONDS = 0.01;
+
+// set up the map like init does, minus the screen and the waiting; false
+// if the map can't be read
+bool startHeadlessLevel(const std::string & path, double think_multiplier, unsigned seed);
+// move the ghosts, after the keys of this tick
+void headlessTick(long tick);
+
+#endif
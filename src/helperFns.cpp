@@ -17,73 +17,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
  */
 
+#include "allocCheck.h"
 #include "globals.h"
 #include "helperFns.h"
+#include "level.h"
+#include <chrono>
+#include <mutex>
 #include <thread>
 #include <sstream>
 #include <unistd.h>
 
-int stuff[] = {'#', static_cast<int>(ACS_ULCORNER), static_cast<int>(ACS_LLCORNER), static_cast<int>(ACS_URCORNER), static_cast<int>(ACS_LRCORNER),
-	static_cast<int>(ACS_LTEE), static_cast<int>(ACS_RTEE), static_cast<int>(ACS_BTEE), static_cast<int>(ACS_TTEE), static_cast<int>(ACS_HLINE), static_cast<int>(ACS_VLINE), static_cast<int>(ACS_PLUS)};
-std::set<int> WALLS(stuff, stuff + 12);
-
-// Return the character at x, y
-chtype charAt(int x, int y) {
-	// check bounds
-	if(x < 0 || y < 0)
-		return 0;
-
-	int curX, curY; // store current position; we will return to it
-
-	// get value
-	getyx(stdscr, curY, curX);
-	chtype value = mvinch(y, x);
-
-	// move back + return
-	mvinch(curY, curX);
-	return value;
-}
-
-// Return the letter ignoring colour at x, y
-chtype letterAt(int x, int y) {
-  return charAt(x, y) & A_CHARTEXT;
-}
-
-bool writeAt(int x, int y, chtype letter) {
-	// Check bounds
-	if(x < 0 || y < 0)
-		return false;
-
-	int curX, curY;
-	getyx(stdscr, curY, curX);
-
-
-	mvinch(y, x);
-
-	addch(letter);
-	mvinch(curY, curX);
-	return true;
+// Return the letter at x, y as it is in the map file, ignoring ghosts
+char32_t letterAt(int x, int y) {
+  return board.letter(x, y);
 }
 
-bool writeAt(int x, int y, chtype letter, int color) {
-	// Check bounds
-	if(x < 0 || y < 0)
-		return false;
-
-	int curX, curY;
-	getyx(stdscr, curY, curX);
-
-
-	mvinch(y, x);
-	attron(COLOR_PAIR(color));
-	addch(letter);
-	attroff(COLOR_PAIR(color));
-	mvinch(curY, curX);
-
-	return true;
+double gameTime() {
+  std::chrono::duration<double> since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+  return since_epoch.count();
 }
 
-void writeError(std::string msg) {
+void writeError(const char * msg) {
+	// off the beaten track, so a game tick may log (see allocCheck.h)
+	AllocExempt exempt;
+	// ghosts may report problems from the worker threads
+	static std::mutex log_lock;
+	std::lock_guard<std::mutex> guard(log_lock);
 	std::ofstream fs;
 	fs.open("errors.log", std::fstream::app);
 	fs << msg;
@@ -91,13 +50,17 @@ void writeError(std::string msg) {
 	fs.close();
 }
 
+void writeError(const std::string & msg) {
+	writeError(msg.c_str());
+}
+
 void printAtBottomChar(char msg) {
 	std::string x;
 	x += msg;
 	mvprintw(MAP_END+5, 0, "%s", (x).c_str());
 }
 
-void printAtBottom(std::string msg) {
+void printAtBottom(const std::string & msg) {
 	int x, y;
 	getyx(stdscr, y, x);
 	mvprintw(MAP_END+1, 1, "%s", msg.c_str());
@@ -105,6 +68,28 @@ void printAtBottom(std::string msg) {
 	move(y,x);
 }
 
+// leaves room for "Points: 1234/1234" and " Lives: 3"
+static const int TIMINGS_COLUMN = 24;
+
+void printTimings(const std::vector<std::string> & lines) {
+	int x, y;
+	getyx(stdscr, y, x);
+	for (unsigned i = 0; i < lines.size(); ++i) {
+		mvprintw(MAP_END + 1 + i, TIMINGS_COLUMN, "%s", lines[i].c_str());
+	}
+	move(y,x);
+}
+
+void clearTimings(int line_count) {
+	int x, y;
+	getyx(stdscr, y, x);
+	for (int i = 0; i < line_count; ++i) {
+		move(MAP_END + 1 + i, TIMINGS_COLUMN);
+		clrtoeol();
+	}
+	move(y,x);
+}
+
 // Game state
 void winGame() {
 	clear();
@@ -144,45 +129,23 @@ void loseGame() {
 }
 
 
-bool isWall(chtype character) {
-  return WALLS.find(character) != WALLS.end();
-}
-
-
 // check to see if the player can move there
 bool isValid(int x, int y, bool ignoreWalls) {
-	// Within range of board
-	if(y < 0 || x < 0 || x > WIDTH + 1)
-		return false;
-	
-
-	// Move cursor, check character, move cursor back
-	int curX, curY;
-	getyx(stdscr, curY, curX);
-	chtype testPos= mvinch(y, x);
-	mvinch(curY, curX);
-
-
-	// Now see if it's a valid spot
-	if(!ignoreWalls && (testPos >= 4000000 || isWall(testPos)))
-	{
-		return false;
-	}
-	return true;	
+  return board.isValid(x, y, ignoreWalls);
 }
 
 int find_reachable_line(int lineNumber, bool searchForwards) {
   lineNumber = std::max(0, std::min(lineNumber, MAP_END - MAP_BEGIN));
   int offset_from_start = lineNumber - 1;
   int real_line_number = MAP_BEGIN + offset_from_start;
-  int x_start_of_line = reachability_map.first_reachable_index_on_line(real_line_number);
+  int x_start_of_line = level.reachability.first_reachable_index_on_line(real_line_number);
   while(real_line_number >= MAP_BEGIN && real_line_number <= MAP_END && x_start_of_line == -1) {
     if (searchForwards) {
 	    ++real_line_number;
 	  } else {
 	    --real_line_number;
 	  }
-    x_start_of_line = reachability_map.first_reachable_index_on_line(real_line_number);
+    x_start_of_line = level.reachability.first_reachable_index_on_line(real_line_number);
   }
   if (x_start_of_line != -1) {
     return real_line_number;
@@ -190,4 +153,3 @@ int find_reachable_line(int lineNumber, bool searchForwards) {
     return -1;
   }
 }
-
@@ -16,13 +16,7 @@ You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
  */
-#ifdef __APPLE__
-#include <curses.h>
-#elif __FreeBSD__
-#include <curses.h>
-#else
-#include <ncurses.h>
-#endif
+#include "terminal.h"
 
 
 #ifndef HELPERFNS_H
@@ -32,16 +26,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //#include <ncursesw/cursesw.h>
 #include <fstream>
 #include <string>
+#include <vector>
 
-// Return the character at x, y
-chtype charAt(int x, int y);
-// Return just the letter at x,y ignoring colour
-chtype letterAt(int x, int y);
-bool writeAt(int x, int y, chtype letter);
-bool writeAt(int x, int y, chtype letter, int color);
-void writeError(std::string msg);
+// Return just the letter at x,y, as in the map file ('#' for walls)
+char32_t letterAt(int x, int y);
+void writeError(const char * msg);
+void writeError(const std::string & msg);
 void printAtBottomChar(char msg);
-void printAtBottom(std::string msg);
+void printAtBottom(const std::string & msg);
+// the F2 timing overlay, to the right of the printAtBottom lines
+void printTimings(const std::vector<std::string> & lines);
+void clearTimings(int line_count);
+// seconds on a steady clock, for timing ghost moves
+double gameTime();
 
 
 
@@ -51,7 +48,6 @@ void loseGame();
 
 // note isInside has been replaced with a more robust method, see reachableMap.h
 
-bool isWall(chtype character);
 // check to see if the player can move there
 bool isValid(int x, int y, bool ignoreWalls = false);
 
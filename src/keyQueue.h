@@ -0,0 +1,68 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef KEYQUEUE_H
+#define KEYQUEUE_H
+
+// A fixed size queue of keys for exactly one writer and one reader, which
+// may be different processes: it only holds plain data and lock-free
+// atomics, so it can live in shared memory (see coop.h). Neither side ever
+// waits; push fails when the queue is full.
+
+#include <atomic>
+#include <cstdint>
+
+#if ATOMIC_INT_LOCK_FREE != 2
+#error "KeyQueue needs lock-free atomics to be shared between processes"
+#endif
+
+class KeyQueue {
+public:
+  static const uint32_t SIZE = 256; // a power of two
+
+  // writer side
+  bool push(int key) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == SIZE) {
+      return false;
+    }
+    keys[t % SIZE] = key;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // reader side
+  bool pop(int & key) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    key = keys[h % SIZE];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // on their own cache lines, so the two sides don't slow each other down
+  alignas(64) std::atomic<uint32_t> head{0}; // written by the reader
+  alignas(64) std::atomic<uint32_t> tail{0}; // written by the writer
+  alignas(64) int32_t keys[SIZE];
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "keystroke.h"
+
+namespace {
+
+// what a key means outside of the f/F/t/T and g states
+enum class KeyClass : unsigned char {
+  Ignored, // does nothing, cancels a count
+  Digit,   // 0-9; 0 without a count is LineBegin
+  Find,    // f F t T
+  G,       // g
+  Motion,  // any other key that is a command on its own
+};
+
+struct KeyTable {
+  KeyClass key_class[128];
+  Command command[128];
+
+  KeyTable() {
+    for (int k = 0; k < 128; ++k) {
+      key_class[k] = KeyClass::Ignored;
+      command[k] = Command::None;
+    }
+    for (int k = '0'; k <= '9'; ++k) {
+      key_class[k] = KeyClass::Digit;
+    }
+    key_class['g'] = KeyClass::G;
+    find('f', Command::FindForward);
+    find('F', Command::FindBackward);
+    find('t', Command::TillForward);
+    find('T', Command::TillBackward);
+    motion('h', Command::Left);
+    motion('j', Command::Down);
+    motion('k', Command::Up);
+    motion('l', Command::Right);
+    motion('w', Command::WordForward);
+    motion('W', Command::BigWordForward);
+    motion('b', Command::WordBackward);
+    motion('B', Command::BigWordBackward);
+    motion('e', Command::WordEnd);
+    motion('E', Command::BigWordEnd);
+    motion('$', Command::LineEnd);
+    motion('^', Command::FirstNonBlank);
+    motion('%', Command::Percent);
+    motion(';', Command::RepeatFind);
+    motion(',', Command::RepeatFindReverse);
+    motion('G', Command::LastLine); // GotoLine with a count
+    motion('H', Command::GotoLine);
+    motion('L', Command::LastLine);
+    motion('M', Command::MiddleLine);
+    motion('q', Command::Quit);
+    motion('!', Command::ToggleFreeze);
+    motion('&', Command::Cheat);
+    motion('u', Command::Undo);
+    motion(0x12, Command::Redo); // Ctrl-R
+  }
+
+  void find(char key, Command c) {
+    key_class[static_cast<int>(key)] = KeyClass::Find;
+    command[static_cast<int>(key)] = c;
+  }
+  void motion(char key, Command c) {
+    key_class[static_cast<int>(key)] = KeyClass::Motion;
+    command[static_cast<int>(key)] = c;
+  }
+};
+
+const KeyTable TABLE;
+
+} // namespace
+
+void KeyParser::reset() {
+  current = State::Start;
+  count = 0;
+  counted = false;
+  find = Command::None;
+  target = 0;
+  target_bytes_left = 0;
+}
+
+Keystroke KeyParser::finish(Command command, char32_t target) {
+  Keystroke done;
+  done.command = command;
+  done.counted = counted;
+  done.count = counted ? count : 1;
+  done.target = target;
+  reset();
+  return done;
+}
+
+Keystroke KeyParser::feed(char key) {
+  if (current == State::Find) {
+    // any character can be the target, encoded as UTF-8
+    unsigned char byte = key;
+    if (target_bytes_left > 0 && (byte & 0xC0) == 0x80) {
+      target = target << 6 | (byte & 0x3F);
+      return --target_bytes_left == 0 ? finish(find, target) : Keystroke();
+    }
+    if (byte >= 0xC2 && byte <= 0xF4) {
+      target_bytes_left = byte >= 0xF0 ? 3 : byte >= 0xE0 ? 2 : 1;
+      target = byte & (0x3F >> target_bytes_left);
+      return Keystroke();
+    }
+    return finish(find, byte);
+  }
+  int k = static_cast<unsigned char>(key);
+  KeyClass key_class = k < 128 ? TABLE.key_class[k] : KeyClass::Ignored;
+  if (current == State::G) {
+    if (key_class == KeyClass::G) {
+      // gg goes to the first line, 12gg to line 12
+      return finish(Command::GotoLine);
+    }
+    reset(); // g followed by anything else means nothing
+    return Keystroke();
+  }
+
+  switch (key_class) {
+    case KeyClass::Digit:
+      if (current == State::Start && key == '0') {
+        return finish(Command::LineBegin);
+      }
+      count = count * 10 + (key - '0');
+      if (count > MAX_COUNT) {
+        count = MAX_COUNT;
+      }
+      counted = true;
+      current = State::Count;
+      return Keystroke();
+    case KeyClass::Find:
+      find = TABLE.command[k];
+      current = State::Find;
+      return Keystroke();
+    case KeyClass::G:
+      current = State::G;
+      return Keystroke();
+    case KeyClass::Motion: {
+      Command command = TABLE.command[k];
+      if (command == Command::LastLine && key == 'G' && counted) {
+        command = Command::GotoLine; // 12G
+      }
+      return finish(command);
+    }
+    default:
+      reset();
+      return Keystroke();
+  }
+}
+
+const char * keystrokeName(const Keystroke & keystroke, bool pending) {
+  if (keystroke.command == Command::None) {
+    return pending ? "pending" : "other";
+  }
+  if (keystroke.counted) {
+    return "counted";
+  }
+  switch (keystroke.command) {
+    case Command::Left: return "h";
+    case Command::Down: return "j";
+    case Command::Up: return "k";
+    case Command::Right: return "l";
+    case Command::WordForward: return "w";
+    case Command::BigWordForward: return "W";
+    case Command::WordBackward: return "b";
+    case Command::BigWordBackward: return "B";
+    case Command::WordEnd: return "e";
+    case Command::BigWordEnd: return "E";
+    case Command::LineBegin: return "0";
+    case Command::LineEnd: return "$";
+    case Command::FirstNonBlank: return "^";
+    case Command::Percent: return "%";
+    case Command::FindForward: return "f";
+    case Command::FindBackward: return "F";
+    case Command::TillForward: return "t";
+    case Command::TillBackward: return "T";
+    case Command::RepeatFind: return ";";
+    case Command::RepeatFindReverse: return ",";
+    case Command::GotoLine: return "gg";
+    case Command::LastLine: return "G";
+    case Command::MiddleLine: return "M";
+    case Command::Undo: return "u";
+    case Command::Redo: return "^R";
+    default: return "other";
+  }
+}
@@ -0,0 +1,81 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef KEYSTROKE_H
+#define KEYSTROKE_H
+
+// Turns the keys the player types into vim commands, one key at a time.
+// The parser is a small state machine: a count being typed, an f/F/t/T
+// waiting for its target character (which takes a few keys when it is
+// UTF-8 encoded), or a g waiting for the second g.
+// What a key does in a state is looked up in a fixed table, so feeding a
+// key never allocates, parses strings or throws.
+
+enum class Command : unsigned char {
+  None, // nothing to do (yet)
+  Left, Down, Up, Right,
+  WordForward, BigWordForward, WordBackward, BigWordBackward, WordEnd, BigWordEnd,
+  LineBegin, LineEnd, FirstNonBlank, Percent,
+  FindForward, FindBackward, TillForward, TillBackward, // f F t T
+  RepeatFind, RepeatFindReverse, // ; ,
+  GotoLine, // gg, H, or #G: count is the line number
+  LastLine, // G, L
+  MiddleLine, // M
+  Quit, // q: not how you quit vim
+  ToggleFreeze, // !
+  Cheat, // &
+  Undo, Redo, // u and Ctrl-R, in practice mode: step back and forth in time
+};
+
+struct Keystroke {
+  Command command = Command::None;
+  int count = 1; // the typed count, 1 if none
+  bool counted = false; // whether a count was typed
+  char32_t target = '\0'; // for f/F/t/T
+};
+
+class KeyParser {
+public:
+  enum class State : unsigned char { Start, Count, Find, G };
+  // counts above this are clamped; no map is anywhere near this big
+  static const int MAX_COUNT = 99999;
+
+  // feed one key; returns the command it completes, or Command::None when
+  // the key only started a command (or means nothing)
+  Keystroke feed(char key);
+  void reset();
+  State state() const { return current; }
+  bool pending() const { return current != State::Start; }
+
+private:
+  State current = State::Start;
+  int count = 0;
+  bool counted = false;
+  Command find = Command::None; // which of f/F/t/T is waiting in State::Find
+  char32_t target = 0; // as far as it has been typed
+  int target_bytes_left = 0; // continuation bytes still to come
+
+  Keystroke finish(Command command, char32_t target = '\0');
+};
+
+// short name of a command for reports: "w", "f", "gg", "counted", ...
+// "pending" for keys that only started a command
+const char * keystrokeName(const Keystroke & keystroke, bool pending);
+
+#endif
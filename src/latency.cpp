@@ -0,0 +1,152 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "latency.h"
+#include "globals.h"
+#include "helperFns.h"
+#include "keystroke.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+int LatencyHistogram::bucketOf(uint64_t us) {
+  if (us < SUB_BUCKETS) {
+    return us;
+  }
+  int top_bit = 63 - __builtin_clzll(us);
+  int shift = top_bit - (SUB_BUCKET_BITS - 1);
+  if (shift > MAX_SHIFT) {
+    return BUCKETS - 1;
+  }
+  // us >> shift is in [HALF, SUB_BUCKETS)
+  return shift * HALF + (us >> shift);
+}
+
+uint64_t LatencyHistogram::valueOf(int bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  int shift = (bucket - HALF) / HALF;
+  uint64_t sub = bucket - shift * HALF;
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t us) {
+  ++counts[bucketOf(us)];
+  ++total;
+  if (us > max_value) {
+    max_value = us;
+  }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t wanted = static_cast<uint64_t>(fraction * total + 0.5);
+  if (wanted < 1) {
+    wanted = 1;
+  }
+  uint64_t seen = 0;
+  for (int b = 0; b < BUCKETS; ++b) {
+    seen += counts[b];
+    if (seen >= wanted) {
+      return std::min(valueOf(b), max_value);
+    }
+  }
+  return max_value;
+}
+
+void LatencyHistogram::add(const LatencyHistogram & other) {
+  for (int b = 0; b < BUCKETS; ++b) {
+    counts[b] += other.counts[b];
+  }
+  total += other.total;
+  if (other.max_value > max_value) {
+    max_value = other.max_value;
+  }
+}
+
+LatencyStats::LatencyStats() {
+  // Redo is the last command
+  for (int c = 0; c <= static_cast<int>(Command::Redo); ++c) {
+    Keystroke keystroke;
+    keystroke.command = static_cast<Command>(c);
+    by_motion[keystrokeName(keystroke, false)];
+    keystroke.counted = true;
+    by_motion[keystrokeName(keystroke, true)];
+  }
+}
+
+bool LatencyStats::empty() const {
+  for (auto & motion : by_motion) {
+    if (motion.second.count() > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LatencyStats::record(const char * motion, double read_time, double flush_time) {
+  double us = (flush_time - read_time) * 1e6;
+  by_motion[motion].record(us < 0 ? 0 : static_cast<uint64_t>(us));
+}
+
+void LatencyStats::write(std::ostream & out) const {
+  char line[100];
+  out << "keypress to screen latency in microseconds" << std::endl;
+  snprintf(line, sizeof(line), "%-8s %8s %8s %8s %8s %8s", "motion", "count", "p50", "p90", "p99", "max");
+  out << line << std::endl;
+  LatencyHistogram all;
+  auto writeRow = [&](const std::string & name, const LatencyHistogram & h) {
+    snprintf(line, sizeof(line), "%-8s %8llu %8llu %8llu %8llu %8llu", name.c_str(),
+             (unsigned long long) h.count(), (unsigned long long) h.percentile(0.5),
+             (unsigned long long) h.percentile(0.9), (unsigned long long) h.percentile(0.99),
+             (unsigned long long) h.max());
+    out << line << std::endl;
+  };
+  for (auto & motion : by_motion) {
+    if (motion.second.count() == 0) {
+      continue;
+    }
+    writeRow(motion.first, motion.second);
+    all.add(motion.second);
+  }
+  writeRow("all", all);
+}
+
+void writeLatencyReport() {
+  if (latency_stats.empty()) {
+    return;
+  }
+  if (LATENCY_REPORT_FILE.empty()) {
+    std::stringstream ss;
+    latency_stats.write(ss);
+    writeError(ss.str());
+    return;
+  }
+  std::ofstream out(LATENCY_REPORT_FILE.c_str());
+  if (!out) {
+    writeError("Cannot write latency report to " + LATENCY_REPORT_FILE);
+    return;
+  }
+  latency_stats.write(out);
+}
@@ -0,0 +1,71 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Keypress to screen latency: every key read in playGame is stamped when it
+// is read and again once the frame showing its effect has been flushed to
+// the terminal. The difference goes into a histogram per motion type, and
+// the percentiles are written out when the game exits.
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+// HDR style histogram of microsecond values: 32 linear buckets, then 16
+// buckets per power of two, so every bucket is within about 6% of the
+// values counted in it, from a microsecond up to hours.
+class LatencyHistogram {
+  enum { SUB_BUCKET_BITS = 5, SUB_BUCKETS = 1 << SUB_BUCKET_BITS, HALF = SUB_BUCKETS / 2 };
+  enum { MAX_SHIFT = 32, BUCKETS = SUB_BUCKETS + MAX_SHIFT * HALF };
+  uint64_t counts[BUCKETS] = {0};
+  uint64_t total = 0;
+  uint64_t max_value = 0;
+
+  static int bucketOf(uint64_t us);
+  // the highest value that lands in the bucket
+  static uint64_t valueOf(int bucket);
+
+public:
+  void record(uint64_t us);
+  uint64_t count() const { return total; }
+  uint64_t max() const { return max_value; }
+  // the value at or below which the given fraction (0..1) of the samples fall
+  uint64_t percentile(double fraction) const;
+  void add(const LatencyHistogram & other);
+};
+
+class LatencyStats {
+  // has every motion from the start, so recording never allocates
+  std::map<std::string, LatencyHistogram> by_motion;
+
+public:
+  LatencyStats();
+  // motion is a keystrokeName: "w", "f", "gg", "counted", "pending", ...
+  void record(const char * motion, double read_time, double flush_time);
+  bool empty() const;
+  void write(std::ostream & out) const;
+};
+
+// writes the report to LATENCY_REPORT_FILE, or errors.log if none was given
+void writeLatencyReport();
+
+#endif
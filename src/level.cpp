@@ -0,0 +1,181 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "level.h"
+#include "generator.h"
+#include "mapFile.h"
+#include "rowScan.h"
+
+#include <sstream>
+
+static Ghost_Species speciesOf(char species_id) {
+  switch (species_id) {
+    case 'r': return Ghost_Species::Lemming;
+    case 'c': return Ghost_Species::Clockwise_Lemming;
+    case 'a': return Ghost_Species::AntiClockwise_Lemming;
+    case 's': return Ghost_Species::Agent_Smith;
+    default: return Ghost_Species::Seeker;
+  }
+}
+
+Level::Level() : Level(ArenaAllocator<char>(std::make_shared<Arena>())) {}
+
+Level::Level(const ArenaAllocator<char> & allocator)
+  : ghosts(allocator), doors(allocator), reachability(allocator), terrain(allocator) {}
+
+// the wall character depends on the position of the other walls,
+// EG: is the wall a corner, a straight line, etc?
+Wall wallShape(bool left, bool right, bool up, bool down) {
+  if (left && right && up && down)
+    return Wall::Plus;
+  if (left && right && up)
+    return Wall::BTee;
+  if (left && right && down)
+    return Wall::TTee;
+  if (left && up && down)
+    return Wall::RTee;
+  if (right && up && down)
+    return Wall::LTee;
+  if (up && left)
+    return Wall::LRCorner;
+  if (up && right)
+    return Wall::LLCorner;
+  if (down && left)
+    return Wall::URCorner;
+  if (down && right)
+    return Wall::ULCorner;
+  if (down || up)
+    return Wall::VLine;
+  return Wall::HLine;
+}
+
+// a map file, or a generated level by its name
+static bool readMap(const std::string & path, MapFile & map) {
+  unsigned seed;
+  int width, height;
+  if (!parseGeneratedLevelName(path, seed, width, height)) {
+    return loadMapFile(path, map);
+  }
+  std::string text;
+  if (!generateMap(seed, width, height, text)) {
+    return false;
+  }
+  std::istringstream in(text);
+  parseMapFile(in, map);
+  return true;
+}
+
+bool loadLevel(const std::string & path, Level & level) {
+  MapFile map;
+  if (!readMap(path, map)) {
+    // an empty level rather than the one that was loaded before
+    level = Level();
+    return false;
+  }
+  buildLevel(path, map, level);
+  return true;
+}
+
+void buildLevel(const std::string & path, const MapFile & map, Level & level) {
+  // a fresh arena; the old level's memory goes once nothing uses it
+  level = Level();
+  level.path = path;
+  level.width = map.width;
+  level.map_end = map.rows.size();
+  for (const std::u32string & row : map.rows) {
+    level.reachability.addLine(row);
+  }
+  level.map_begin = 0;
+  for (int row = 0; row < level.map_end; ++row) {
+    if (level.reachability.first_reachable_index_on_line(row) != -1) {
+      level.map_begin = row;
+      break;
+    }
+  }
+
+  // map x is screen x - 2, the line numbers come first
+  level.board_width = level.width + 2;
+  level.board_height = level.map_end;
+  level.terrain.assign(level.board_width * level.board_height, Terrain());
+  auto at = [&](int x, int y) -> char32_t {
+    const std::u32string & row = map.rows[y];
+    return x >= 0 && x < static_cast<int>(row.length()) ? row[x] : ' ';
+  };
+  for (int y = 0; y < level.map_end; ++y) {
+    Terrain * row = &level.terrain[y * level.board_width];
+    if (level.reachability.first_reachable_index_on_line(y) != -1) {
+      std::string line_number = std::to_string(y);
+      if (line_number.length() < 2) {
+        line_number = " " + line_number;
+      }
+      for (int j = 0; j < 2; ++j) {
+        row[j].letter = line_number[j];
+        row[j].color = LINE_NUMBER_COLOR;
+      }
+    }
+    // the rest of the row is already blank
+    const std::u32string & cells = map.rows[y];
+    for (int x = 0; x < static_cast<int>(cells.length()); ++x) {
+      Terrain & cell = row[x + 2];
+      char32_t c = cells[x];
+      cell.letter = c;
+      if (c == '#') {
+        cell.color = WALL_COLOR; // yellow, but can change
+        cell.wall = wallShape(x >= 1 && cells[x - 1] == '#', at(x + 1, y) == '#',
+                              y >= 1 && at(x, y - 1) == '#',
+                              y + 1 < level.map_end && at(x, y + 1) == '#');
+      } else if (c == '~') {
+        // special color for tilde keys
+        cell.color = TILDE_COLOR;
+      } else if (c != ' ' && c != WIDE_TAIL) {
+        // a letter the player has to step on to win
+        cell.point = true;
+      }
+    }
+    // points are counted a row at a time: all cells but blanks, walls, ~
+    // and the right halves of wide characters (scanByte 0x80)
+    static const ByteClass POINTS(" #~\x80", true);
+    const ArenaString & bytes = level.reachability.line(y);
+    level.total_points += countInClass(bytes.data(), bytes.length(), POINTS);
+  }
+
+  for (const GhostLine & line : map.ghosts) {
+    GhostSpawn ghost;
+    ghost.species = speciesOf(line.species_id);
+    ghost.think = line.think;
+    ghost.x = line.x + 2;
+    ghost.y = line.y;
+    level.ghosts.push_back(ghost);
+  }
+  for (const DoorLine & line : map.doors) {
+    // --lint complains about doors that aren't walls to begin with
+    if (line.y < 0 || line.y >= level.map_end || at(line.x, line.y) != '#') {
+      continue;
+    }
+    level.doors.push_back({line.x + 2, line.y, line.switch_x + 2, line.switch_y});
+  }
+  if (map.player_start_specified) {
+    level.start_x = map.start_x + 2;
+    level.start_y = map.start_y;
+  } else {
+    // in case 'p' is not specified, the middle of the map
+    level.start_x = level.width / 2 + 2;
+    level.start_y = (level.map_end - level.map_begin) / 2;
+  }
+}
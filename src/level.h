@@ -0,0 +1,79 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef LEVEL_H
+#define LEVEL_H
+
+// A map file, parsed and analysed once: the terrain with its wall shapes,
+// line numbers and points, the reachability map, and where everybody
+// starts. Nothing in here changes while playing, except the reachability
+// map while doors are open (see doors.h), so trying a level again only
+// needs the board reset to this terrain, the doors closed and everybody
+// respawned.
+//
+// All of it but the path lives in the level's own arena (see arena.h):
+// building a level is a few large allocations instead of one per line and
+// run, and the memory of the previous level goes back in one go.
+
+#include <string>
+#include "arena.h"
+#include "board.h"
+#include "ghost1.h"
+#include "mapFile.h"
+#include "reachableMap.h"
+
+// a door is a wall until a player steps on its switch; screen coordinates
+struct Door {
+  int x, y;
+  int switch_x, switch_y;
+};
+
+struct Level {
+  // with a new, empty arena
+  Level();
+
+  std::string path; // what was loaded, empty if nothing yet
+  int width = 0; // WIDTH: the longest line in the file
+  int map_begin = 0; // MAP_BEGIN
+  int map_end = 0; // MAP_END: the number of map rows
+  int total_points = 0;
+  int start_x = 0; // screen coordinates
+  int start_y = 0;
+  ArenaVector<GhostSpawn> ghosts;
+  ArenaVector<Door> doors; // closed in terrain and reachability
+  ReachableMap reachability;
+  // the board's terrain layer, board_width x board_height cells
+  int board_width = 0;
+  int board_height = 0;
+  ArenaVector<Terrain> terrain;
+
+private:
+  // the containers share the arena, and keep it alive
+  explicit Level(const ArenaAllocator<char> & allocator);
+};
+
+// Parse and analyse the map file into level; false if it couldn't be read.
+// path may also name a generated level (see generator.h).
+bool loadLevel(const std::string & path, Level & level);
+// the same for a map that has been parsed already
+void buildLevel(const std::string & path, const MapFile & map, Level & level);
+// the shape of a wall cell, given which of its neighbours are walls too
+Wall wallShape(bool left, bool right, bool up, bool down);
+
+#endif
@@ -0,0 +1,323 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "lint.h"
+#include "reachableMap.h"
+#include "threadPool.h"
+#include "unicode.h"
+
+#include <iostream>
+
+namespace {
+
+// the map as the game sees it: rows padded with spaces up to the width
+class LintedMap {
+  const std::string & name;
+  const MapFile & map;
+  std::vector<std::string> & problems;
+
+public:
+  ReachableMap reachability;
+  int first_walkable_row = -1;
+  // door cells that have been opened, by the flood fill below
+  std::vector<char> opened;
+
+  LintedMap(const std::string & n, const MapFile & m, std::vector<std::string> & p)
+    : name(n), map(m), problems(p), opened(m.width * m.rows.size(), 0) {
+    for (unsigned row = 0; row < map.rows.size(); ++row) {
+      reachability.addLine(map.rows[row]);
+    }
+    for (unsigned row = 0; row < map.rows.size() && first_walkable_row == -1; ++row) {
+      if (reachability.first_reachable_index_on_line(row) != -1) {
+        first_walkable_row = row;
+      }
+    }
+  }
+
+  int width() const { return map.width; }
+  int height() const { return map.rows.size(); }
+
+  bool inside(int x, int y) const {
+    return y >= 0 && y < height() && x >= 0 && x < width();
+  }
+
+  char32_t at(int x, int y) const {
+    const std::u32string & row = map.rows[y];
+    return x < static_cast<int>(row.length()) ? row[x] : ' ';
+  }
+
+  bool walkable(int x, int y) const {
+    return inside(x, y) && (at(x, y) != '#' || opened[y * width() + x]);
+  }
+
+  bool isPoint(int x, int y) const {
+    char32_t c = at(x, y);
+    return c != '~' && c != ' ' && c != '#' && c != WIDE_TAIL;
+  }
+
+  void report(int line_number, const std::string & message) {
+    problems.push_back(name + ":" + std::to_string(line_number + 1) + ": " + message);
+  }
+
+  static std::string where(int x, int y) {
+    return "(" + std::to_string(x) + ", " + std::to_string(y) + ")";
+  }
+
+  // shared checks for anything that spawns on the map
+  bool checkSpawn(const std::string & what, int x, int y, int line_number) {
+    if (!inside(x, y)) {
+      report(line_number, what + " " + where(x, y) + " is outside the map");
+      return false;
+    }
+    if (at(x, y) == '#') {
+      report(line_number, what + " " + where(x, y) + " is on a wall");
+      return false;
+    }
+    if (!reachability.reachable(x, y)) {
+      report(line_number, what + " " + where(x, y) + " is outside the reachable part of the map");
+      return false;
+    }
+    return true;
+  }
+};
+
+void checkFirstWalkableRow(LintedMap & m) {
+  if (m.first_walkable_row == -1) {
+    m.report(0, "map has no reachable characters at all");
+  } else if (m.first_walkable_row != 1) {
+    // drawScreen calls this MAP_BEGIN; line numbers are off if it isn't 1
+    m.report(m.first_walkable_row, "first walkable line is line "
+             + std::to_string(m.first_walkable_row + 1)
+             + ", must be line 2 or line numbers will be incorrect");
+  }
+}
+
+// returns false if there is no sensible place to flood-fill from
+bool checkPlayer(LintedMap & m, const MapFile & map, int & start_x, int & start_y) {
+  if (map.player_start_specified) {
+    start_x = map.start_x;
+    start_y = map.start_y;
+  } else {
+    // same default as drawScreen
+    int map_begin = m.first_walkable_row == -1 ? 0 : m.first_walkable_row;
+    start_x = map.width / 2;
+    start_y = (m.height() - map_begin) / 2;
+  }
+  int line_number = map.player_start_specified ? map.start_line_number : m.height() - 1;
+  std::string what = map.player_start_specified ? "player start" : "default player start (no p line)";
+  if (!m.checkSpawn(what, start_x, start_y, line_number)) {
+    return false;
+  }
+  if (m.at(start_x, start_y) == '~') {
+    m.report(line_number, what + " " + LintedMap::where(start_x, start_y) + " is on a ~");
+    return false;
+  }
+  return true;
+}
+
+void checkDoors(LintedMap & m, const MapFile & map) {
+  for (const DoorLine & door : map.doors) {
+    if (!m.inside(door.x, door.y)) {
+      m.report(door.line_number, "door " + LintedMap::where(door.x, door.y) + " is outside the map");
+    } else if (m.at(door.x, door.y) != '#') {
+      m.report(door.line_number, "door " + LintedMap::where(door.x, door.y)
+               + " must be a # in the map");
+    }
+    std::string what = "switch " + LintedMap::where(door.switch_x, door.switch_y);
+    if (!m.inside(door.switch_x, door.switch_y)) {
+      m.report(door.line_number, what + " is outside the map");
+    } else if (m.at(door.switch_x, door.switch_y) == '#') {
+      m.report(door.line_number, what + " is on a wall");
+    } else if (m.at(door.switch_x, door.switch_y) == '~') {
+      m.report(door.line_number, what + " is on a ~");
+    }
+  }
+}
+
+void checkGhosts(LintedMap & m, const MapFile & map, int start_x, int start_y) {
+  static const int dx[] = {0, 1, 0, -1};
+  static const int dy[] = {-1, 0, 1, 0};
+  for (const GhostLine & ghost : map.ghosts) {
+    if (!m.checkSpawn("ghost", ghost.x, ghost.y, ghost.line_number)) {
+      continue;
+    }
+    if (ghost.x == start_x && ghost.y == start_y) {
+      m.report(ghost.line_number, "ghost " + LintedMap::where(ghost.x, ghost.y)
+               + " spawns on the player");
+    }
+    bool can_move = false;
+    for (int d = 0; d < 4; ++d) {
+      can_move |= m.walkable(ghost.x + dx[d], ghost.y + dy[d]);
+    }
+    if (!can_move) {
+      m.report(ghost.line_number, "ghost " + LintedMap::where(ghost.x, ghost.y)
+               + " is boxed in by walls");
+    }
+  }
+}
+
+// where % takes you from the bracket at x, y; mirrors avatar::percentJump
+bool percentTarget(const LintedMap & m, int x, int y, int & target_x, int & target_y) {
+  static const std::string brackets = "({[)}]";
+  static const std::string opposites = ")}]({[";
+  char32_t c = m.at(x, y);
+  size_t which = c < 0x80 ? brackets.find(static_cast<char>(c)) : std::string::npos;
+  if (which == std::string::npos) {
+    return false;
+  }
+  char32_t opposite = static_cast<unsigned char>(opposites[which]);
+  int offset = which < 3 ? 1 : -1;
+  int last_row = m.height() - 1 - m.first_walkable_row; // HEIGHT in the game
+  for (target_y = y; target_y >= 0 && target_y < last_row; target_y += offset) {
+    int start_x = target_y == y ? x + offset : (offset == 1 ? 0 : m.width() - 1);
+    for (target_x = start_x; m.inside(target_x, target_y); target_x += offset) {
+      if (m.at(target_x, target_y) == opposite) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Flood fill everything the player can get to from the start. Walking (hjkl,
+// w/e/b) never crosses a wall or a ~; f/t/F/T (with a count) reach anything
+// on the line up to the next wall, even across a ~; % jumps to the matching
+// bracket anywhere; and 0, $, gg and #G reach the first and last reachable
+// character of every line. Reaching a switch opens its doors.
+void checkPointsReachable(LintedMap & m, const MapFile & map, int start_x, int start_y,
+                          bool start_valid) {
+  std::vector<char> seen(m.width() * m.height(), 0);
+  std::vector<int> todo;
+  // visiting a cell visits the whole stretch of line between two walls
+  auto visit = [&](int x, int y) {
+    if (!m.walkable(x, y) || m.at(x, y) == '~' || seen[y * m.width() + x]) {
+      return;
+    }
+    int left = x, right = x;
+    while (m.walkable(left - 1, y)) {
+      --left;
+    }
+    while (m.walkable(right + 1, y)) {
+      ++right;
+    }
+    for (int sx = left; sx <= right; ++sx) {
+      if (m.at(sx, y) != '~') {
+        seen[y * m.width() + sx] = 1;
+        todo.push_back(y * m.width() + sx);
+      }
+    }
+  };
+  if (start_valid) {
+    visit(start_x, start_y);
+  }
+  for (int y = 0; y < m.height(); ++y) {
+    int first = m.reachability.first_reachable_index_on_line(y);
+    int last = m.reachability.last_reachable_index_on_line(y);
+    if (first != -1) {
+      // the reachability map counts in screen columns, which have the two
+      // line number columns in front
+      visit(first - 2, y);
+      visit(last - 2, y);
+    }
+  }
+  while (!todo.empty()) {
+    int cell = todo.back();
+    todo.pop_back();
+    int x = cell % m.width(), y = cell / m.width();
+    visit(x, y - 1);
+    visit(x, y + 1);
+    int target_x, target_y;
+    if (percentTarget(m, x, y, target_x, target_y)) {
+      visit(target_x, target_y);
+    }
+    for (const DoorLine & door : map.doors) {
+      if (door.switch_x == x && door.switch_y == y && m.inside(door.x, door.y)
+          && m.at(door.x, door.y) == '#' && !m.opened[door.y * m.width() + door.x]) {
+        m.opened[door.y * m.width() + door.x] = 1;
+        visit(door.x, door.y);
+      }
+    }
+  }
+  for (int y = 0; y < m.height(); ++y) {
+    int unreachable = 0, first_x = -1;
+    for (int x = 0; x < m.width(); ++x) {
+      if (m.isPoint(x, y) && !seen[y * m.width() + x]) {
+        if (first_x == -1) {
+          first_x = x;
+        }
+        ++unreachable;
+      }
+    }
+    if (unreachable > 0) {
+      m.report(y, std::to_string(unreachable) + " point(s) can never be reached, the first at "
+               + LintedMap::where(first_x, y));
+    }
+  }
+}
+
+} // namespace
+
+std::vector<std::string> lintMap(const std::string & name, const MapFile & map) {
+  std::vector<std::string> problems;
+  LintedMap m(name, map, problems);
+  for (const MapIssue & issue : map.issues) {
+    m.report(issue.line_number, issue.message);
+  }
+  if (map.rows.empty()) {
+    m.report(0, "map is empty");
+    return problems;
+  }
+  checkFirstWalkableRow(m);
+  int start_x, start_y;
+  bool start_valid = checkPlayer(m, map, start_x, start_y);
+  checkGhosts(m, map, start_x, start_y);
+  checkDoors(m, map);
+  checkPointsReachable(m, map, start_x, start_y, start_valid);
+  return problems;
+}
+
+int lintMaps(const std::vector<std::string> & paths) {
+  if (paths.empty()) {
+    std::cerr << "Usage: pacvim --lint maps/*.txt" << std::endl;
+    return 2;
+  }
+  std::vector<std::vector<std::string>> problems(paths.size());
+  ThreadPool pool;
+  pool.parallel_for(paths.size(), [&](size_t i) {
+    MapFile map;
+    if (!loadMapFile(paths[i], map)) {
+      problems[i].push_back(paths[i] + ": cannot open file");
+      return;
+    }
+    problems[i] = lintMap(paths[i], map);
+  });
+
+  // report in the order the files were given, whatever order they finished in
+  int total = 0, bad_maps = 0;
+  for (auto & map_problems : problems) {
+    for (auto & problem : map_problems) {
+      std::cerr << problem << std::endl;
+    }
+    total += map_problems.size();
+    bad_maps += map_problems.empty() ? 0 : 1;
+  }
+  std::cout << paths.size() << " map(s) checked, " << total << " problem(s) in "
+            << bad_maps << " map(s)" << std::endl;
+  return total == 0 ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef LINT_H
+#define LINT_H
+
+#include <string>
+#include <vector>
+#include "mapFile.h"
+
+// Checks one parsed map for everything that would otherwise only show up
+// in errors.log (or not at all) while playing it. Returns one message per
+// problem, formatted as "<name>:<line>: <message>".
+std::vector<std::string> lintMap(const std::string & name, const MapFile & map);
+
+// pacvim --lint maps/*.txt
+// lints all the given map files in parallel, prints the problems found
+// and returns the process exit code (0 if every map is fine)
+int lintMaps(const std::vector<std::string> & paths);
+
+#endif
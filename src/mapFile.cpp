@@ -0,0 +1,166 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "mapFile.h"
+#include "unicode.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+bool isGhostSpecies(char c) {
+  return c == '/' || c == 'r' || c == 'c' || c == 'a' || c == 's';
+}
+
+bool isDefinitionLine(const std::string & line) {
+  if (line.empty()) {
+    return false;
+  }
+  // a map line may well start with a d, a door line is d and a number
+  bool door = line[0] == 'd' && line.length() > 1 && std::isdigit(static_cast<unsigned char>(line[1]));
+  return isGhostSpecies(line[0]) || line[0] == 'p' || door;
+}
+
+// read an int or double starting at *pos, skipping leading spaces;
+// moves *pos past it and returns false if there is no number there
+static bool readInt(const char ** pos, int & value) {
+  char * end;
+  long parsed = std::strtol(*pos, &end, 10);
+  if (end == *pos) {
+    return false;
+  }
+  value = static_cast<int>(parsed);
+  *pos = end;
+  return true;
+}
+
+static bool readDouble(const char ** pos, double & value) {
+  char * end;
+  value = std::strtod(*pos, &end);
+  if (end == *pos) {
+    return false;
+  }
+  *pos = end;
+  return true;
+}
+
+static bool onlySpacesLeft(const char * pos) {
+  return pos[std::strspn(pos, " \t\r")] == '\0';
+}
+
+static void parseGhostLine(const std::string & line, int line_number, MapFile & map) {
+  GhostLine ghost;
+  ghost.species_id = line[0];
+  ghost.line_number = line_number;
+  const char * pos = line.c_str() + 1;
+  if (!readDouble(&pos, ghost.think) || !readInt(&pos, ghost.x) || !readInt(&pos, ghost.y)
+      || !onlySpacesLeft(pos)) {
+    map.issues.push_back({line_number, "malformed ghost line '" + line
+                          + "', expected <species><think time> <x> <y>, e.g. /1.5 19 7"});
+    return;
+  }
+  if (ghost.think <= 0) {
+    map.issues.push_back({line_number, "ghost think time must be positive"});
+    return;
+  }
+  map.ghosts.push_back(ghost);
+}
+
+static void parsePlayerLine(const std::string & line, int line_number, MapFile & map) {
+  const char * pos = line.c_str() + 1;
+  int x, y;
+  if (!readInt(&pos, x) || !readInt(&pos, y) || !onlySpacesLeft(pos)) {
+    map.issues.push_back({line_number, "malformed player line '" + line
+                          + "', expected p<x> <y>, e.g. p15 7"});
+    return;
+  }
+  if (map.player_start_specified) {
+    map.issues.push_back({line_number, "player start already given on line "
+                          + std::to_string(map.start_line_number + 1)});
+  }
+  map.player_start_specified = true;
+  map.start_x = x;
+  map.start_y = y;
+  map.start_line_number = line_number;
+}
+
+static void parseDoorLine(const std::string & line, int line_number, MapFile & map) {
+  DoorLine door;
+  door.line_number = line_number;
+  const char * pos = line.c_str() + 1;
+  if (!readInt(&pos, door.x) || !readInt(&pos, door.y) || !readInt(&pos, door.switch_x)
+      || !readInt(&pos, door.switch_y) || !onlySpacesLeft(pos)) {
+    map.issues.push_back({line_number, "malformed door line '" + line
+                          + "', expected d<x> <y> <switch x> <switch y>, e.g. d10 5 3 7"});
+    return;
+  }
+  map.doors.push_back(door);
+}
+
+void parseMapFile(std::istream & in, MapFile & map) {
+  std::string line;
+  // map lines are decoded here and copied out: copying a row is cheaper
+  // than zero-filling a new one to decode into
+  std::u32string cells;
+  bool seen_definition = false;
+  for (int line_number = 0; std::getline(in, line); ++line_number) {
+    if (line_number == 0 && line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+      line.erase(0, 3); // the byte order mark some editors start UTF-8 files with
+    }
+    if (!isDefinitionLine(line)) {
+      if (seen_definition && line.find_first_not_of(' ') != std::string::npos) {
+        map.issues.push_back({line_number, "map text after ghost/player/door definitions; "
+                              "definitions must be at the bottom of the file"});
+      }
+      unsigned changes = decodeCells(line, cells);
+      map.rows.push_back(cells);
+      if (changes & INVALID_UTF8) {
+        map.issues.push_back({line_number, "line is not valid UTF-8; the bad bytes show as U+FFFD"});
+      }
+      if (changes & DROPPED_ZERO_WIDTH) {
+        map.issues.push_back({line_number, "combining characters are left out; "
+                              "use precomposed ones (NFC): U+00E9 rather than e and U+0301"});
+      }
+      if (map.width < static_cast<int>(map.rows.back().length())) {
+        map.width = map.rows.back().length();
+      }
+      continue;
+    }
+    if (map.width < static_cast<int>(line.length())) {
+      map.width = line.length();
+    }
+    seen_definition = true;
+    if (line[0] == 'p') {
+      parsePlayerLine(line, line_number, map);
+    } else if (line[0] == 'd') {
+      parseDoorLine(line, line_number, map);
+    } else {
+      parseGhostLine(line, line_number, map);
+    }
+  }
+}
+
+bool loadMapFile(const std::string & path, MapFile & map) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  parseMapFile(in, map);
+  return true;
+}
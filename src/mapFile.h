@@ -0,0 +1,83 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+// Parsing of maps/*.txt without touching the screen, so that maps can be
+// checked (pacvim --lint) without starting a game.
+//
+// A map file is the map itself, followed by definition lines:
+//   /1.5 19 7   ghost; species char, think time, x and y
+//   p15 7       player start
+//   d10 5 3 7   door at 10 5, a # that opens and closes whenever a player
+//               steps on the switch at 3 7
+// x and y are the column and line in the map text, both counted from 0.
+//
+// The map text is UTF-8, and is decoded into cells of one screen column
+// each as it is read (see unicode.h); x counts those cells, not bytes.
+
+#include <istream>
+#include <string>
+#include <vector>
+
+struct GhostLine {
+  char species_id; // '/' seeker, 'r' lemming, 'c'/'a' (anti)clockwise lemming, 's' agent smith
+  double think;
+  int x;
+  int y;
+  int line_number; // 0-based line in the file
+};
+
+struct DoorLine {
+  int x;
+  int y;
+  int switch_x;
+  int switch_y;
+  int line_number; // 0-based line in the file
+};
+
+struct MapIssue {
+  int line_number; // 0-based line in the file
+  std::string message;
+};
+
+struct MapFile {
+  std::vector<std::u32string> rows; // map text, one entry per screen line, one cell per column
+  std::vector<GhostLine> ghosts;
+  std::vector<DoorLine> doors;
+  bool player_start_specified = false;
+  int start_x = 0;
+  int start_y = 0;
+  int start_line_number = -1;
+  // longest line in the file in columns, definition lines included (like drawScreen)
+  int width = 0;
+  // malformed definition lines and the like
+  std::vector<MapIssue> issues;
+};
+
+// true for ghost, player and door definitions; these are not part of the map text
+bool isDefinitionLine(const std::string & line);
+bool isGhostSpecies(char c);
+
+void parseMapFile(std::istream & in, MapFile & map);
+// false if the file could not be opened
+bool loadMapFile(const std::string & path, MapFile & map);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "mapWatcher.h"
+#include "lint.h"
+#include "mapFile.h"
+
+#include <cerrno>
+#include <climits>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+bool MapWatcher::start(const std::string & map_path) {
+#ifndef __linux__
+  // only inotify is supported so far; --dev says so and gives up
+  (void) map_path;
+  errno = ENOSYS;
+  return false;
+#else
+  path = map_path;
+  size_t slash = path.rfind('/');
+  std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+  file_name = slash == std::string::npos ? path : path.substr(slash + 1);
+  inotify_fd = inotify_init1(IN_CLOEXEC);
+  if (inotify_fd == -1) {
+    return false;
+  }
+  if (inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1
+      || pipe(stop_pipe) == -1) {
+    int error = errno;
+    close(inotify_fd);
+    inotify_fd = -1;
+    errno = error;
+    return false;
+  }
+  thread = std::thread(&MapWatcher::run, this);
+  return true;
+#endif
+}
+
+void MapWatcher::stop() {
+  if (!watching()) {
+    return;
+  }
+  char stop = 0;
+  if (write(stop_pipe[1], &stop, 1) == 1 && thread.joinable()) {
+    thread.join();
+  }
+  close(stop_pipe[0]);
+  close(stop_pipe[1]);
+  close(inotify_fd);
+  inotify_fd = -1;
+}
+
+bool MapWatcher::takeReload(Reload & reload) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!ready) {
+    return false;
+  }
+  reload = std::move(*ready);
+  ready.reset();
+  return true;
+}
+
+bool MapWatcher::waitForSave() {
+#ifndef __linux__
+  return false;
+#else
+  alignas(inotify_event) char events[sizeof(inotify_event) + NAME_MAX + 1];
+  pollfd fds[] = {{inotify_fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) == -1 && errno != EINTR) {
+      return false;
+    }
+    if (fds[1].revents) {
+      return false;
+    }
+    if (!(fds[0].revents & POLLIN)) {
+      continue;
+    }
+    ssize_t length = read(inotify_fd, events, sizeof(events));
+    for (ssize_t at = 0; at < length;) {
+      const inotify_event * event = reinterpret_cast<const inotify_event *>(events + at);
+      if (event->len > 0 && file_name == event->name) {
+        return true;
+      }
+      at += sizeof(inotify_event) + event->len;
+    }
+  }
+#endif
+}
+
+void MapWatcher::run() {
+  while (waitForSave()) {
+    std::unique_ptr<Reload> reload(new Reload);
+    reload->saved = Clock::now();
+    MapFile map;
+    if (loadMapFile(path, map)) {
+      buildLevel(path, map, reload->level);
+      reload->problems = lintMap(path, map);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ready = std::move(reload); // an older one nobody took is out of date
+  }
+}
@@ -0,0 +1,70 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef MAPWATCHER_H
+#define MAPWATCHER_H
+
+// pacvim --dev maps/mapX.txt: play one map over and over while editing it.
+// A thread waits for the map to be saved (inotify, on the map's directory,
+// so editors that save by writing a new file and renaming it are seen too),
+// then loads and lints it right away, off the game's thread. The game only
+// has to swap the finished level in, between two frames. Watching needs
+// inotify, so --dev only works on Linux.
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "level.h"
+
+class MapWatcher {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Reload {
+    Level level; // empty path if the map couldn't be read
+    std::vector<std::string> problems; // as --lint reports them
+    Clock::time_point saved; // when the save was seen
+  };
+
+  // false, with errno set, if the map can't be watched
+  bool start(const std::string & path);
+  void stop();
+  bool watching() const { return inotify_fd != -1; }
+  // the map as last saved, if it was saved since the last call
+  bool takeReload(Reload & reload);
+
+  ~MapWatcher() { stop(); }
+
+private:
+  std::string path;
+  std::string file_name; // path without the directory, as inotify reports it
+  int inotify_fd = -1;
+  int stop_pipe[2] = {-1, -1};
+  std::thread thread;
+  std::mutex mutex;
+  std::unique_ptr<Reload> ready; // guarded by mutex
+
+  void run();
+  bool waitForSave(); // false once stopped
+};
+
+#endif
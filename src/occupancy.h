@@ -0,0 +1,123 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+// Which entity (player or ghost) stands on every cell of the board, kept up
+// to date on every spawn and move. Collision and proximity checks look here
+// instead of reading colours back off the screen, so they keep working when
+// colours are off or the ghost is not drawn.
+
+#include <vector>
+
+typedef int EntityId;
+const EntityId NO_ENTITY = 0;
+const EntityId PLAYER_ENTITY = 1;
+const EntityId PARTNER_ENTITY = 2; // the second player in a --host game
+const EntityId FIRST_GHOST_ENTITY = 3; // ghosts[i] is FIRST_GHOST_ENTITY + i
+
+inline bool isGhostEntity(EntityId id) {
+  return id >= FIRST_GHOST_ENTITY;
+}
+
+inline bool isPlayerEntity(EntityId id) {
+  return id == PLAYER_ENTITY || id == PARTNER_ENTITY;
+}
+
+class OccupancyGrid {
+  int width = 0;
+  int height = 0;
+  std::vector<EntityId> cells;
+  struct Position { int x, y; };
+  std::vector<Position> positions; // indexed by EntityId, {-1, -1} when not placed
+
+  bool inside(int x, int y) const {
+    return x >= 0 && y >= 0 && x < width && y < height;
+  }
+
+public:
+  // empty the grid, for a board of the given size (in screen cells)
+  void reset(int w, int h) {
+    width = w;
+    height = h;
+    cells.assign(width * height, NO_ENTITY);
+    positions.clear();
+  }
+
+  EntityId at(int x, int y) const {
+    return inside(x, y) ? cells[y * width + x] : NO_ENTITY;
+  }
+
+  bool ghostAt(int x, int y) const {
+    return isGhostEntity(at(x, y));
+  }
+
+  // either player
+  bool playerAt(int x, int y) const {
+    return isPlayerEntity(at(x, y));
+  }
+
+  bool placed(EntityId id) const {
+    return id < static_cast<EntityId>(positions.size()) && positions[id].x != -1;
+  }
+
+  // where the entity is; false if it isn't on the board
+  bool position(EntityId id, int & x, int & y) const {
+    if (!placed(id)) {
+      return false;
+    }
+    x = positions[id].x;
+    y = positions[id].y;
+    return true;
+  }
+
+  void remove(EntityId id) {
+    if (!placed(id)) {
+      return;
+    }
+    Position & p = positions[id];
+    if (inside(p.x, p.y) && cells[p.y * width + p.x] == id) {
+      cells[p.y * width + p.x] = NO_ENTITY;
+    }
+    p.x = p.y = -1;
+  }
+
+  // make room for ids below count, so placing them never allocates
+  void reserve(EntityId count) {
+    if (count > static_cast<EntityId>(positions.size())) {
+      positions.resize(count, Position{-1, -1});
+    }
+  }
+
+  // put the entity on x, y, taking it off wherever it was before
+  void place(EntityId id, int x, int y) {
+    remove(id);
+    if (id >= static_cast<EntityId>(positions.size())) {
+      positions.resize(id + 1, Position{-1, -1});
+    }
+    positions[id].x = x;
+    positions[id].y = y;
+    if (inside(x, y)) {
+      cells[y * width + x] = id;
+    }
+  }
+};
+
+#endif
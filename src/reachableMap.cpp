@@ -0,0 +1,220 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "reachableMap.h"
+#include "rowScan.h"
+#include "trace.h"
+#include "unicode.h"
+
+#include <algorithm>
+
+ReachableMap::ReachableMap(const ArenaAllocator<char> & alloc)
+  : allocator(alloc), rows(alloc), runs(alloc), group_inside(alloc), first_index(alloc),
+    last_index(alloc), new_line(alloc), todo(alloc), lines_touched(alloc) {}
+
+void ReachableMap::splitLine(const ArenaString & row, ArenaVector<Run> & line) {
+  static const ByteClass WALL('#');
+  static const ByteClass OPEN("#", true);
+  static const ByteClass LETTER(" #", true);
+  line.clear();
+  const char * bytes = row.data();
+  int length = row.length();
+  // a run goes from a cell that isn't a wall up to the next wall
+  for (int x = scanRight(bytes, 0, length, OPEN, NO_STOP); x != -1;) {
+    int end = scanRight(bytes, x, length, WALL, NO_STOP);
+    if (end == -1) {
+      end = length;
+    }
+    bool has_char = scanRight(bytes, x, end, LETTER, NO_STOP) != -1;
+    line.push_back({x, end - 1, has_char, NO_GROUP});
+    x = scanRight(bytes, end, length, OPEN, NO_STOP);
+  }
+}
+
+const ReachableMap::Run * ReachableMap::runAt(int x, int y) const {
+  if (y < 0 || y >= static_cast<int>(runs.size())) {
+    return nullptr;
+  }
+  const ArenaVector<Run> & line = runs[y];
+  auto run = std::lower_bound(line.begin(), line.end(), x,
+                              [](const Run & r, int value) { return r.x_end < value; });
+  return run != line.end() && run->x_start <= x ? &*run : nullptr;
+}
+
+void ReachableMap::flood(int y, size_t index) {
+  int group = group_inside.size();
+  group_inside.push_back(0);
+  todo.clear();
+  todo.push_back(std::make_pair(y, index));
+  runs[y][index].group = group;
+  while (!todo.empty()) {
+    int line = todo.back().first;
+    const Run run = runs[line][todo.back().second];
+    todo.pop_back();
+    group_inside[group] |= run.has_char;
+    lines_touched.push_back(line);
+    for (int next = line - 1; next <= line + 1; next += 2) {
+      if (next < 0 || next >= static_cast<int>(runs.size())) {
+        continue;
+      }
+      ArenaVector<Run> & other = runs[next];
+      // the runs of the next line that overlap this one
+      auto it = std::lower_bound(other.begin(), other.end(), run.x_start,
+                                 [](const Run & r, int value) { return r.x_end < value; });
+      for (; it != other.end() && it->x_start <= run.x_end; ++it) {
+        if (it->group != group) {
+          it->group = group;
+          todo.push_back(std::make_pair(next, static_cast<size_t>(it - other.begin())));
+        }
+      }
+    }
+  }
+}
+
+void ReachableMap::updateLine(int y) {
+  first_index[y] = last_index[y] = -1;
+  for (const Run & run : runs[y]) {
+    if (group_inside[run.group]) {
+      if (first_index[y] == -1) {
+        first_index[y] = run.x_start + 2;
+      }
+      last_index[y] = run.x_end + 2;
+    }
+  }
+}
+
+void ReachableMap::numberAll() {
+  TRACE_SPAN("ReachableMap::numberAll");
+  group_inside.clear();
+  for (ArenaVector<Run> & line : runs) {
+    for (Run & run : line) {
+      run.group = NO_GROUP;
+    }
+  }
+  for (size_t y = 0; y < runs.size(); ++y) {
+    for (size_t i = 0; i < runs[y].size(); ++i) {
+      if (runs[y][i].group == NO_GROUP) {
+        lines_touched.clear(); // all lines are updated below anyway
+        flood(y, i);
+      }
+    }
+  }
+  for (size_t y = 0; y < runs.size(); ++y) {
+    updateLine(y);
+  }
+  groups_numbered = group_inside.size();
+  numbered = true;
+}
+
+void ReachableMap::addLine(const std::u32string & cells) {
+  rows.push_back(ArenaString(cells.length(), ' ', allocator));
+  narrowCells(cells.data(), cells.length(), &rows.back()[0]);
+  runs.emplace_back(allocator);
+  splitLine(rows.back(), runs.back());
+  first_index.push_back(-1);
+  last_index.push_back(-1);
+  numbered = false;
+}
+
+void ReachableMap::clear() {
+  rows.clear();
+  runs.clear();
+  group_inside.clear();
+  first_index.clear();
+  last_index.clear();
+  groups_numbered = 0;
+  numbered = true;
+}
+
+bool ReachableMap::reachable(int x, int y) {
+  if (!numbered) {
+    numberAll();
+  }
+  const Run * run = runAt(x, y);
+  return run && group_inside[run->group];
+}
+
+int ReachableMap::first_reachable_index_on_line(int y) {
+  if (!numbered) {
+    numberAll();
+  }
+  return y >= 0 && y < static_cast<int>(first_index.size()) ? first_index[y] : -1;
+}
+
+int ReachableMap::last_reachable_index_on_line(int y) {
+  if (!numbered) {
+    numberAll();
+  }
+  return y >= 0 && y < static_cast<int>(last_index.size()) ? last_index[y] : -1;
+}
+
+void ReachableMap::setCell(int x, int y, char c) {
+  TRACE_SPAN("ReachableMap::setCell");
+  if (y < 0 || y >= static_cast<int>(rows.size()) || x < 0 || x >= static_cast<int>(rows[y].length())
+      || rows[y][x] == c) {
+    return;
+  }
+  rows[y][x] = c;
+  splitLine(rows[y], new_line);
+  if (!numbered) {
+    runs[y].swap(new_line);
+    return;
+  }
+  // runs away from x are as they were and keep their group
+  for (Run & run : new_line) {
+    if (run.x_end < x - 1 || run.x_start > x + 1) {
+      run.group = runAt(run.x_start, y)->group;
+    }
+  }
+  runs[y].swap(new_line);
+
+  // Every run that was connected through x, y, or is now, is next to it:
+  // on the line itself, or overlapping x on the lines above and below.
+  // Numbering those again, with new numbers, covers all the groups that
+  // were split or joined.
+  size_t first_new_group = group_inside.size();
+  lines_touched.clear();
+  lines_touched.push_back(y); // even if its run at x is gone
+  auto renumber = [&](int line, int from, int to) {
+    if (line < 0 || line >= static_cast<int>(runs.size())) {
+      return;
+    }
+    for (size_t i = 0; i < runs[line].size(); ++i) {
+      const Run & run = runs[line][i];
+      if (run.x_end >= from && run.x_start <= to
+          && (run.group == NO_GROUP || static_cast<size_t>(run.group) < first_new_group)) {
+        flood(line, i);
+      }
+    }
+  };
+  renumber(y, x - 1, x + 1);
+  renumber(y - 1, x, x);
+  renumber(y + 1, x, x);
+
+  std::sort(lines_touched.begin(), lines_touched.end());
+  lines_touched.erase(std::unique(lines_touched.begin(), lines_touched.end()), lines_touched.end());
+  for (int line : lines_touched) {
+    updateLine(line);
+  }
+  // the old groups are never used again; start over before there are
+  // too many of them
+  if (group_inside.size() > 2 * groups_numbered + 64) {
+    numberAll();
+  }
+}
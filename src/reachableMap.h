@@ -37,239 +37,69 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // character should be accessible to the player, and by this definition and
 // algorithm, we can establish for every line which x positions can be jumped 
 // to safely without ending up outside the map.
+//
+// Every line is split into runs: stretches without walls. Runs on
+// neighbouring lines that overlap are connected, and every run is numbered
+// with the group of runs it is connected to; a group is inside if any of
+// its runs holds a character. The map can also change after it has been
+// built (doors opening and closing): setCell only renumbers the groups
+// that meet at the changed cell, so its cost is proportional to the part
+// of the map connected to that cell, not to the whole map.
 
-#include <vector>
 #include <string>
-#include <cassert>
-#include <iostream>
-#include <sstream>
-#include <algorithm>
-
-// sections are parts of a line, defined by the indexes of the first
-// and last reachable characters on the line. For passages 1-char wide,
-// the x_start and x_end are the same
-struct Section {
-  int x_start, x_end;
-  bool isInside; // whether it contains a non-space char
-
-  bool overlaps(const Section & otherSection) {
-    bool overlaps = (otherSection.x_start <= x_end) && (otherSection.x_end >= x_start);
-    return overlaps;
-  }
-};
-
-// a (horizontal) line, contains sections and can be built up from a string
-struct Line {
-  std::vector<Section> sections;
-
-  void addChar(int index, char c) {
-    bool isInside = c != ' ';
-    if (sections.empty()) {
-      sections.push_back({index, index, isInside});
-    } else {
-      Section last_section = sections[sections.size() - 1];
-      if (last_section.x_end != index - 1) {
-        // discontinuous index means new section
-        sections.push_back({index, index, isInside});
-      } else {
-        // continuous index means expand last section to include index
-        last_section.x_end = index;
-        if (isInside) {
-          last_section.isInside = true;
-        }
-        // replace last element with modified copy
-        sections.pop_back();
-        sections.push_back(last_section);
-      }
-    }
-  }
-
-  Line(std::string str) {
-    for(int i = 0; i < str.length(); i++) {
-      char const c = str[i];
-      if (c == '#') {
-        continue;
-      }
-      addChar(i, c);
-    }
-  }
-
-  Section section_at(int index) {
-    for(Section & s : sections) {
-      if (s.x_start <= index && s.x_end >= index) {
-        return s;
-      }
-    }
-    return {-1, -1, false};
-  }
-};
-
-// Represents a set of sections that are connected to each other
-// if one has a non-space character, they are all marked "inside"
-// and are therefore reachable by jumps
-class SectionGroup {
-  bool is_inside;
-  std::vector<Section *> sections;
-  std::vector<Section *> bottom;
-  std::vector<Section *> next_bottom;
-
-public:
-  SectionGroup() : is_inside(false) {
-  }
-
-  SectionGroup(Section * s) : is_inside(false) {
-    addSection(s);
-  }
-
-  void addSection(Section * s, bool addBottom = true){
-    if (s->isInside) {
-      is_inside = true;
-      for (auto existing_s : sections) {
-        existing_s->isInside = true;
-      }
-    } else if (is_inside) {
-      s->isInside = true;
-    }
-    sections.push_back(s);
-    if (addBottom) {
-      bottom.push_back(s);
-    }
-  }
-
-  bool bottom_touches(Section s) {
-    for(Section * b : bottom) {
-      if (b->overlaps(s)) {
-        return true;
-      }
-    }
-    return false;
-  }
-
-  void addToNextBottom(Section * s){
-    addSection(s, false);
-    next_bottom.push_back(s);
-  }
-
-  void line_finished(){
-    bottom.swap(next_bottom);
-    next_bottom.clear();
-  }
-
-  void merge(SectionGroup * g){
-    is_inside |= g->is_inside;
-    for (auto s : g->sections) {
-      addSection(s, false);
-    }
-    for(auto s : g->bottom) {
-      if (std::find(bottom.begin(), bottom.end(), s) == bottom.end()) {
-        bottom.push_back(s);
-      }
-    }
-  }
-};
+#include <utility>
+#include "arena.h"
 
 class ReachableMap {
-  std::vector<Line> lines;
-
-  // the frontline contains all open-ended sectiongroups (bottoms), which we might still add sections to
-  std::vector<SectionGroup> frontline;
+  struct Run {
+    int x_start, x_end; // both included; for passages 1-char wide, the same
+    bool has_char; // contains a non-space char
+    int group;
+  };
+  static const int NO_GROUP = -1;
+
+  ArenaAllocator<char> allocator;
+  ArenaVector<ArenaString> rows; // scanByte per cell (see unicode.h): '#' for walls, ' ' for blanks
+  ArenaVector<ArenaVector<Run>> runs; // per line, left to right
+  ArenaVector<char> group_inside; // per group number
+  size_t groups_numbered = 0; // by the last numberAll
+  // per line, the first and last reachable index (screen columns), or -1
+  ArenaVector<int> first_index;
+  ArenaVector<int> last_index;
+  bool numbered = true; // false after addLine, until the next question
+  // scratch space, kept so that setCell doesn't allocate once it has run
+  // a few times
+  ArenaVector<Run> new_line;
+  ArenaVector<std::pair<int, size_t>> todo;
+  ArenaVector<int> lines_touched;
+
+  static void splitLine(const ArenaString & row, ArenaVector<Run> & line);
+  const Run * runAt(int x, int y) const;
+  // give the run and everything connected to it a new group number, and
+  // add the lines it spans to lines_touched
+  void flood(int y, size_t index);
+  void updateLine(int y);
+  void numberAll();
 
 public:
-  void addLine(std::string str) {
-    std::vector<std::vector<SectionGroup *>> frontline_groups_to_join;
-    lines.push_back(Line(str));
-    Line & newline = lines[lines.size()-1];
-    // sections in the new line that are not connected to the previous
-    // line at all are added as new frontline SectionGroups,
-    // each containing 1 section
-    std::vector<Section *> new_frontline_sections;
-    // iterate over all the new line's sections
-    for(Section & s : newline.sections) {
-      // the list of bottoms section s touches
-      std::vector<SectionGroup *> bottoms_touching;
-      for (SectionGroup & g : frontline) {
-        if (g.bottom_touches(s)) {
-          bottoms_touching.push_back(&g);
-          // potentially add multiple sections to the next bottom for g
-          g.addToNextBottom(&s);
-        }
-      }
-      if (bottoms_touching.empty()) {
-        // since it doesn't touch any existing ones, this is a new SectionGroup
-        new_frontline_sections.push_back(&s);
-      } else if (bottoms_touching.size() > 1) {
-        // going to merge SectionGroups
-        frontline_groups_to_join.push_back(bottoms_touching);
-      }
-    }
-    for (SectionGroup & g : frontline) {
-      g.line_finished();
-    }
-    for (auto join_vector : frontline_groups_to_join) {
-      // merging SectionGroups
-      SectionGroup newGroup;
-      // join the groups in this vector
-      for (SectionGroup * sg : join_vector) {
-        newGroup.merge(sg);
-      }
-      // remove them all from frontline
-      frontline.erase(std::remove_if(frontline.begin(), frontline.end(),
-        [&](SectionGroup & s) { 
-          return std::find(join_vector.begin(), join_vector.end(), &s) != join_vector.end();
-        }), frontline.end());
-      // add the result again
-      frontline.push_back(newGroup);
-    }
-    for (Section * s : new_frontline_sections) {
-      // new SectionGroups, each containing 1 section
-      frontline.push_back(SectionGroup(s));
-    }
-  }
-
-  bool reachable(int x, int y) {
-    if (lines.empty() || y < 0 || y > lines.size() - 1) {
-      return false;
-    }
-    Section s = lines[y].section_at(x);
-    return s.isInside;
-  }
-
-  int first_reachable_index_on_line(int y) {
-    if (lines.empty() || y < 0 || y > lines.size() - 1) {
-      return -1;
-    }
-    Line l = lines[y];
-    if (l.sections.empty()) {
-      return -1;
-    }
-    for (int section_index = 0; section_index < l.sections.size(); ++section_index) {
-      if (l.sections[section_index].isInside) {
-        return l.sections[section_index].x_start + 2;
-      }
-    }
-    return -1;
-  }
-
-  int last_reachable_index_on_line(int y) {
-    if (lines.empty() || y < 0 || y > lines.size() - 1) {
-      return -1;
-    }
-    Line l = lines[y];
-    if (l.sections.empty()) {
-      return -1;
-    }
-    for (int section_index = l.sections.size() - 1; section_index >= 0; --section_index) {
-      if (l.sections[section_index].isInside) {
-        return l.sections[section_index].x_end + 2;
-      }
-    }
-    return -1;
-  }
-
-  void clear() {
-    lines.clear();
-    frontline.clear();
-  }
+  // everything is allocated with the given allocator (see arena.h)
+  explicit ReachableMap(const ArenaAllocator<char> & alloc = ArenaAllocator<char>());
+
+  // a line of map cells (see unicode.h)
+  void addLine(const std::u32string & cells);
+  void clear();
+  // line y, a scanByte per cell, as setCell left it
+  const ArenaString & line(int y) const { return rows[y]; }
+
+  // x in map columns
+  bool reachable(int x, int y);
+  // in screen columns (map column + 2)
+  int first_reachable_index_on_line(int y);
+  int last_reachable_index_on_line(int y);
+
+  // put c in map column x of line y ('#' makes it a wall) and work out again
+  // what is reachable around it
+  void setCell(int x, int y, char c);
 };
 
 #endif
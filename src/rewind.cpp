@@ -0,0 +1,227 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "rewind.h"
+#include "avatar.h"
+#include "doors.h"
+#include "globals.h"
+
+History::PlayerState History::playerNow() const {
+  PlayerState p;
+  p.x = player.getX();
+  p.y = player.getY();
+  p.points = player.getPoints();
+  return p;
+}
+
+void History::start() {
+  ticks.resize(TICKS);
+  ghost_changes.resize(GHOST_CHANGES);
+  eaten_cells.resize(EATEN_CELLS);
+  door_changes.resize(DOOR_CHANGES);
+  keyframes.resize(KEYFRAMES);
+  // room for a whole level in every keyframe, so that recording never
+  // allocates
+  for (Keyframe & k : keyframes) {
+    k.tick = -1;
+    k.ghosts.reserve(ghosts.size());
+    k.eaten.reserve(board.eatenLayer().size());
+    k.doors.reserve(doorCount());
+  }
+  newly_eaten.reserve(board.eatenLayer().size());
+  latest = current = 0;
+  ghosts_written = eaten_written = doors_written = 0;
+  oldest_keyframe = 0;
+  last_player = playerNow();
+  last_ghosts.resize(ghosts.size());
+  for (size_t i = 0; i < ghosts.size(); ++i) {
+    last_ghosts[i] = ghosts.state(i);
+  }
+  last_doors.resize(doorCount());
+  for (int door = 0; door < doorCount(); ++door) {
+    last_doors[door] = doorOpen(door);
+  }
+  board.takeNewlyEaten(newly_eaten);
+  Tick & first = tick(0);
+  first = Tick();
+  first.player = last_player;
+  first.ghosts_begin = ghosts_written;
+  first.eaten_begin = eaten_written;
+  first.doors_begin = doors_written;
+  storeKeyframe();
+}
+
+void History::storeKeyframe() {
+  Keyframe & k = keyframe(latest);
+  k.tick = latest;
+  k.player = last_player;
+  k.ghosts = last_ghosts;
+  k.eaten = board.eatenLayer();
+  k.doors = last_doors;
+}
+
+void History::record() {
+  if (rewound()) {
+    return;
+  }
+  board.takeNewlyEaten(newly_eaten);
+  PlayerState p = playerNow();
+  bool player_moved = p.x != last_player.x || p.y != last_player.y || p.points != last_player.points;
+
+  long long ghosts_begin = ghosts_written;
+  for (size_t i = 0; i < ghosts.size(); ++i) {
+    GhostState s = ghosts.state(i);
+    if (s != last_ghosts[i]) {
+      GhostChange & change = ghost_changes[ghosts_written % GHOST_CHANGES];
+      change.ghost = i;
+      change.state = s;
+      ++ghosts_written;
+      last_ghosts[i] = s;
+    }
+  }
+  long long doors_begin = doors_written;
+  for (int door = 0; door < doorCount(); ++door) {
+    if (doorOpen(door) != static_cast<bool>(last_doors[door])) {
+      last_doors[door] = doorOpen(door);
+      door_changes[doors_written % DOOR_CHANGES] = {static_cast<uint32_t>(door), doorOpen(door)};
+      ++doors_written;
+    }
+  }
+  if (!player_moved && ghosts_written == ghosts_begin && newly_eaten.empty()
+      && doors_written == doors_begin) {
+    return; // nothing happened
+  }
+  long long eaten_begin = eaten_written;
+  for (int cell : newly_eaten) {
+    eaten_cells[eaten_written % EATEN_CELLS] = cell;
+    ++eaten_written;
+  }
+
+  ++latest;
+  current = latest;
+  last_player = p;
+  Tick & t = tick(latest);
+  t.player = p;
+  t.ghosts_begin = ghosts_begin;
+  t.ghost_count = ghosts_written - ghosts_begin;
+  t.eaten_begin = eaten_begin;
+  t.eaten_count = eaten_written - eaten_begin;
+  t.doors_begin = doors_begin;
+  t.door_count = doors_written - doors_begin;
+  if (latest % TICKS_PER_KEYFRAME == 0) {
+    storeKeyframe();
+  }
+  forgetOverwritten();
+}
+
+// Drop the oldest keyframe while the ticks after it have been overwritten,
+// in the tick and keyframe rings or in one of the change rings.
+void History::forgetOverwritten() {
+  while (oldest_keyframe + TICKS_PER_KEYFRAME <= latest) {
+    long long first = oldest_keyframe + 1;
+    bool ticks_gone = latest - oldest_keyframe >= TICKS;
+    bool ghosts_gone = ghosts_written - tick(first).ghosts_begin > GHOST_CHANGES;
+    bool eaten_gone = eaten_written - tick(first).eaten_begin > EATEN_CELLS;
+    bool doors_gone = doors_written - tick(first).doors_begin > DOOR_CHANGES;
+    if (!ticks_gone && !ghosts_gone && !eaten_gone && !doors_gone) {
+      return;
+    }
+    oldest_keyframe += TICKS_PER_KEYFRAME;
+  }
+}
+
+void History::apply(const Tick & t, double now) {
+  for (uint32_t c = 0; c < t.ghost_count; ++c) {
+    const GhostChange & change = ghost_changes[(t.ghosts_begin + c) % GHOST_CHANGES];
+    ghosts.restore(change.ghost, change.state, now);
+    last_ghosts[change.ghost] = change.state;
+  }
+  for (uint32_t c = 0; c < t.eaten_count; ++c) {
+    int cell = eaten_cells[(t.eaten_begin + c) % EATEN_CELLS];
+    board.eat(cell % board.getWidth(), cell / board.getWidth());
+  }
+  // the board's doors are set once show has put everybody back
+  for (uint32_t c = 0; c < t.door_count; ++c) {
+    const DoorChange & change = door_changes[(t.doors_begin + c) % DOOR_CHANGES];
+    last_doors[change.door] = change.open;
+  }
+  last_player = t.player;
+}
+
+// put the level in the state it was in at the target tick
+void History::show(long long target, double now) {
+  if (target < current) {
+    const Keyframe & k = keyframe(target - target % TICKS_PER_KEYFRAME);
+    for (size_t i = 0; i < ghosts.size() && i < k.ghosts.size(); ++i) {
+      ghosts.restore(i, k.ghosts[i], now);
+      last_ghosts[i] = k.ghosts[i];
+    }
+    board.setEatenLayer(k.eaten);
+    last_doors = k.doors;
+    last_player = k.player;
+    current = k.tick;
+  }
+  for (; current < target; ++current) {
+    apply(tick(current + 1), now);
+  }
+  board.takeNewlyEaten(newly_eaten); // those were eaten before
+  // after the ghosts, in case one of them was standing on the player
+  player.restore(last_player.x, last_player.y, last_player.points);
+  // last: a door closes over a cell somebody has just left
+  for (int door = 0; door < doorCount(); ++door) {
+    restoreDoor(door, last_doors[door]);
+  }
+  GAME_WON = 0;
+}
+
+bool History::undo(int count, double now) {
+  long long target = current - count;
+  if (target < oldestTick()) {
+    target = oldestTick();
+  }
+  if (target == current) {
+    return false;
+  }
+  show(target, now);
+  return true;
+}
+
+bool History::redo(int count, double now) {
+  long long target = current + count;
+  if (target > latest) {
+    target = latest;
+  }
+  if (target == current) {
+    return false;
+  }
+  show(target, now);
+  return true;
+}
+
+void History::resume() {
+  if (!rewound()) {
+    return;
+  }
+  latest = current;
+  Tick & t = tick(current);
+  ghosts_written = t.ghosts_begin + t.ghost_count;
+  eaten_written = t.eaten_begin + t.eaten_count;
+  doors_written = t.doors_begin + t.door_count;
+  // a keyframe for a later tick is overwritten when we get there again
+}
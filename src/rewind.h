@@ -0,0 +1,128 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef REWIND_H
+#define REWIND_H
+
+// Practice mode history: u steps back in time, Ctrl-R forward again, like
+// undo in vim. Every frame in which something moved is a tick; a tick is
+// stored as what changed in it (where the player went, the cells eaten,
+// the ghosts that moved, with their random generators, the doors that
+// opened or closed). Every
+// TICKS_PER_KEYFRAME ticks the whole state is stored as well. Going back
+// restores the keyframe before the wanted tick and replays the ticks after
+// it, so only changes forward need storing.
+//
+// Everything lives in fixed size rings: when one is full, the oldest
+// keyframe and the ticks after it are forgotten, so a long session never
+// takes more than a few MB.
+
+#include <vector>
+#include <cstdint>
+#include "ghost1.h"
+
+class History {
+public:
+  static const int TICKS_PER_KEYFRAME = 128;
+  static const int KEYFRAMES = 64;
+  static const int TICKS = TICKS_PER_KEYFRAME * KEYFRAMES;
+  static const int GHOST_CHANGES = 1 << 16;
+  static const int EATEN_CELLS = 1 << 14;
+  static const int DOOR_CHANGES = 1 << 12;
+
+  // forget everything and start at the state the level is in now
+  void start();
+  // store what changed since the last tick, if anything did
+  void record();
+
+  // step back / forward count ticks; false if there was nowhere to go
+  bool undo(int count, double now);
+  bool redo(int count, double now);
+  // throw away the ticks after the current one and play on from here
+  void resume();
+
+  // looking at the past: ghosts stay where they are
+  bool rewound() const { return current != latest; }
+  bool canUndo() const { return current > oldestTick(); }
+  long long ticksBack() const { return latest - current; }
+  long long ticksStored() const { return latest - oldestTick(); }
+
+private:
+  struct PlayerState {
+    short x = 0, y = 0;
+    int points = 0;
+  };
+  struct GhostChange {
+    uint32_t ghost;
+    GhostState state;
+  };
+  struct DoorChange {
+    uint32_t door;
+    bool open;
+  };
+  struct Tick {
+    PlayerState player;
+    long long ghosts_begin = 0; // positions in the ghost change, eaten and door rings
+    uint32_t ghost_count = 0;
+    long long eaten_begin = 0;
+    uint32_t eaten_count = 0;
+    long long doors_begin = 0;
+    uint32_t door_count = 0;
+  };
+  struct Keyframe {
+    long long tick = -1;
+    PlayerState player;
+    std::vector<GhostState> ghosts;
+    std::vector<unsigned char> eaten;
+    std::vector<unsigned char> doors; // open or not, per door
+  };
+
+  // ticks are numbered from 0, the state the level started in; the ring
+  // entry for tick t holds the changes that led to it
+  std::vector<Tick> ticks;
+  std::vector<GhostChange> ghost_changes;
+  std::vector<int> eaten_cells;
+  std::vector<DoorChange> door_changes;
+  std::vector<Keyframe> keyframes;
+  long long latest = 0; // newest tick stored
+  long long current = 0; // the tick on the screen
+  long long ghosts_written = 0; // total ever written into the rings
+  long long eaten_written = 0;
+  long long doors_written = 0;
+  long long oldest_keyframe = 0; // tick of the oldest keyframe kept
+
+  // what the last tick looked like, to find out what changed
+  PlayerState last_player;
+  std::vector<GhostState> last_ghosts;
+  std::vector<int> newly_eaten;
+  std::vector<unsigned char> last_doors;
+
+  long long oldestTick() const { return oldest_keyframe; }
+  Keyframe & keyframe(long long tick) {
+    return keyframes[(tick / TICKS_PER_KEYFRAME) % KEYFRAMES];
+  }
+  Tick & tick(long long t) { return ticks[t % TICKS]; }
+  PlayerState playerNow() const;
+  void storeKeyframe();
+  void forgetOverwritten();
+  void apply(const Tick & t, double now);
+  void show(long long target, double now);
+};
+
+#endif
@@ -0,0 +1,394 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "rowScan.h"
+
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__SSE2__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_AVX2 // compiled in always, used if the CPU has it
+#include <immintrin.h>
+#endif
+
+ByteClass::ByteClass(char byte) : count(1), except(false) {
+  bytes[0] = byte;
+  std::fill(table, table + 256, false);
+  table[static_cast<unsigned char>(byte)] = true;
+}
+
+ByteClass::ByteClass(const char * listed, bool e) : count(0), except(e) {
+  std::fill(table, table + 256, except);
+  for (; *listed && count < 8; ++listed) {
+    bytes[count++] = *listed;
+    table[static_cast<unsigned char>(*listed)] = !except;
+  }
+}
+
+namespace {
+
+// what findRight and findLeft return when the stop byte comes first
+const int STOPPED = -2;
+
+int findRight(const char * row, int from, int end, const ByteClass & match, int stop) {
+  for (int x = from; x < end; ++x) {
+    if (static_cast<unsigned char>(row[x]) == stop) {
+      return STOPPED;
+    }
+    if (match.matches(row[x])) {
+      return x;
+    }
+  }
+  return -1;
+}
+
+int findLeft(const char * row, int from, int begin, const ByteClass & match, int stop) {
+  for (int x = from; x >= begin; --x) {
+    if (static_cast<unsigned char>(row[x]) == stop) {
+      return STOPPED;
+    }
+    if (match.matches(row[x])) {
+      return x;
+    }
+  }
+  return -1;
+}
+
+int scalarRight(const char * row, int from, int end, const ByteClass & match, int stop) {
+  return std::max(findRight(row, from, end, match, stop), -1);
+}
+
+int scalarLeft(const char * row, int from, int begin, const ByteClass & match, int stop) {
+  return std::max(findLeft(row, from, begin, match, stop), -1);
+}
+
+int scalarCount(const char * row, int length, const ByteClass & match) {
+  int count = 0;
+  for (int x = 0; x < length; ++x) {
+    count += match.matches(row[x]);
+  }
+  return count;
+}
+
+#ifdef __SSE2__
+// Most scans in a maze end within a few cells, at a wall or at the letter,
+// and those are quicker to look at one by one than to set the vectors up
+// for. The prologues return the answer if the first PROLOGUE cells give
+// it, UNDECIDED otherwise.
+const int PROLOGUE = 8;
+const int UNDECIDED = -3;
+
+int prologueRight(const char * row, int from, int end, const ByteClass & match, int stop) {
+  int prologue_end = std::min(end, from + PROLOGUE);
+  int found = findRight(row, from, prologue_end, match, stop);
+  if (found == -1 && prologue_end < end) {
+    return UNDECIDED;
+  }
+  return std::max(found, -1);
+}
+
+int prologueLeft(const char * row, int from, int begin, const ByteClass & match, int stop) {
+  int prologue_begin = std::max(begin, from - PROLOGUE + 1);
+  int found = findLeft(row, from, prologue_begin, match, stop);
+  if (found == -1 && prologue_begin > begin) {
+    return UNDECIDED;
+  }
+  return std::max(found, -1);
+}
+
+// a class and a stop byte, tested against 16 bytes at a time
+struct Sse2Class {
+  __m128i wanted[8];
+  int count;
+  bool except;
+  __m128i stop;
+  bool stops;
+
+  Sse2Class(const ByteClass & match, int stop_byte)
+    : count(match.count), except(match.except), stops(stop_byte != NO_STOP) {
+    for (int i = 0; i < count; ++i) {
+      wanted[i] = _mm_set1_epi8(match.bytes[i]);
+    }
+    stop = _mm_set1_epi8(static_cast<char>(stop_byte));
+  }
+
+  // a bit per byte, the first byte in the lowest bit
+  void test(const char * at, unsigned & hits, unsigned & walls) const {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(at));
+    __m128i found = _mm_setzero_si128();
+    for (int i = 0; i < count; ++i) {
+      found = _mm_or_si128(found, _mm_cmpeq_epi8(bytes, wanted[i]));
+    }
+    hits = _mm_movemask_epi8(found);
+    if (except) {
+      hits ^= 0xFFFF;
+    }
+    walls = stops ? _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, stop)) : 0;
+  }
+};
+
+// After the prologue, 16 bytes at a time, and the last few in one load
+// that overlaps bytes already looked at, whose bits are shifted out;
+// ranges shorter than 16 bytes are left to the scalar kernel.
+int sse2RightAfterPrologue(const char * row, int from, int end, const ByteClass & match, int stop) {
+  if (end - from < 16) {
+    return scalarRight(row, from, end, match, stop);
+  }
+  Sse2Class scan(match, stop);
+  unsigned hits, walls;
+  int x = from;
+  for (; x + 16 <= end; x += 16) {
+    scan.test(row + x, hits, walls);
+    if (hits | walls) {
+      int first = __builtin_ctz(hits | walls);
+      return walls >> first & 1 ? -1 : x + first;
+    }
+  }
+  if (x == end) {
+    return -1;
+  }
+  int seen = 16 - (end - x);
+  scan.test(row + end - 16, hits, walls);
+  hits >>= seen;
+  walls >>= seen;
+  if (hits | walls) {
+    int first = __builtin_ctz(hits | walls);
+    return walls >> first & 1 ? -1 : x + first;
+  }
+  return -1;
+}
+
+int sse2LeftAfterPrologue(const char * row, int from, int begin, const ByteClass & match, int stop) {
+  if (from - begin + 1 < 16) {
+    return scalarLeft(row, from, begin, match, stop);
+  }
+  Sse2Class scan(match, stop);
+  unsigned hits, walls;
+  int x = from; // the rightmost byte not looked at yet
+  for (; x - 15 >= begin; x -= 16) {
+    scan.test(row + x - 15, hits, walls);
+    if (hits | walls) {
+      int last = 31 - __builtin_clz(hits | walls);
+      return walls >> last & 1 ? -1 : x - 15 + last;
+    }
+  }
+  if (x < begin) {
+    return -1;
+  }
+  unsigned unseen = (1u << (x - begin + 1)) - 1;
+  scan.test(row + begin, hits, walls);
+  hits &= unseen;
+  walls &= unseen;
+  if (hits | walls) {
+    int last = 31 - __builtin_clz(hits | walls);
+    return walls >> last & 1 ? -1 : begin + last;
+  }
+  return -1;
+}
+
+int sse2Right(const char * row, int from, int end, const ByteClass & match, int stop) {
+  int found = prologueRight(row, from, end, match, stop);
+  return found != UNDECIDED ? found : sse2RightAfterPrologue(row, from + PROLOGUE, end, match, stop);
+}
+
+int sse2Left(const char * row, int from, int begin, const ByteClass & match, int stop) {
+  int found = prologueLeft(row, from, begin, match, stop);
+  return found != UNDECIDED ? found : sse2LeftAfterPrologue(row, from - PROLOGUE, begin, match, stop);
+}
+
+int sse2Count(const char * row, int length, const ByteClass & match) {
+  if (length < 16) {
+    return scalarCount(row, length, match);
+  }
+  Sse2Class scan(match, NO_STOP);
+  unsigned hits, walls;
+  int x = 0, count = 0;
+  for (; x + 16 <= length; x += 16) {
+    scan.test(row + x, hits, walls);
+    count += __builtin_popcount(hits);
+  }
+  if (x < length) {
+    scan.test(row + length - 16, hits, walls);
+    count += __builtin_popcount(hits >> (16 - (length - x)));
+  }
+  return count;
+}
+#endif
+
+#ifdef SCAN_AVX2
+#define AVX2 __attribute__((target("avx2,popcnt")))
+
+// as Sse2Class, 32 bytes at a time
+struct Avx2Class {
+  __m256i wanted[8];
+  int count;
+  bool except;
+  __m256i stop;
+  bool stops;
+
+  AVX2 Avx2Class(const ByteClass & match, int stop_byte)
+    : count(match.count), except(match.except), stops(stop_byte != NO_STOP) {
+    for (int i = 0; i < count; ++i) {
+      wanted[i] = _mm256_set1_epi8(match.bytes[i]);
+    }
+    stop = _mm256_set1_epi8(static_cast<char>(stop_byte));
+  }
+
+  AVX2 void test(const char * at, unsigned & hits, unsigned & walls) const {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(at));
+    __m256i found = _mm256_setzero_si256();
+    for (int i = 0; i < count; ++i) {
+      found = _mm256_or_si256(found, _mm256_cmpeq_epi8(bytes, wanted[i]));
+    }
+    hits = _mm256_movemask_epi8(found);
+    if (except) {
+      hits = ~hits;
+    }
+    walls = stops ? _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, stop)) : 0;
+  }
+};
+
+// As the SSE2 kernels, 32 bytes at a time. Ranges shorter than that go to
+// the SSE2 ones before anything touches the wide registers: SSE2 code
+// running while their upper halves are in use is slow on some CPUs.
+AVX2 int avx2Right(const char * row, int from, int end, const ByteClass & match, int stop) {
+  int found = prologueRight(row, from, end, match, stop);
+  if (found != UNDECIDED) {
+    return found;
+  }
+  int x = from + PROLOGUE;
+  if (end - x < 32) {
+    return sse2RightAfterPrologue(row, x, end, match, stop);
+  }
+  Avx2Class scan(match, stop);
+  unsigned hits, walls;
+  for (; x + 32 <= end; x += 32) {
+    scan.test(row + x, hits, walls);
+    if (hits | walls) {
+      int first = __builtin_ctz(hits | walls);
+      return walls >> first & 1 ? -1 : x + first;
+    }
+  }
+  if (x == end) {
+    return -1;
+  }
+  int seen = 32 - (end - x);
+  scan.test(row + end - 32, hits, walls);
+  hits >>= seen;
+  walls >>= seen;
+  if (hits | walls) {
+    int first = __builtin_ctz(hits | walls);
+    return walls >> first & 1 ? -1 : x + first;
+  }
+  return -1;
+}
+
+AVX2 int avx2Left(const char * row, int from, int begin, const ByteClass & match, int stop) {
+  int found = prologueLeft(row, from, begin, match, stop);
+  if (found != UNDECIDED) {
+    return found;
+  }
+  int x = from - PROLOGUE;
+  if (x - begin + 1 < 32) {
+    return sse2LeftAfterPrologue(row, x, begin, match, stop);
+  }
+  Avx2Class scan(match, stop);
+  unsigned hits, walls;
+  for (; x - 31 >= begin; x -= 32) {
+    scan.test(row + x - 31, hits, walls);
+    if (hits | walls) {
+      int last = 31 - __builtin_clz(hits | walls);
+      return walls >> last & 1 ? -1 : x - 31 + last;
+    }
+  }
+  if (x < begin) {
+    return -1;
+  }
+  // x - begin is 30 at most here, so this doesn't shift by 32
+  unsigned unseen = (1u << (x - begin + 1)) - 1;
+  scan.test(row + begin, hits, walls);
+  hits &= unseen;
+  walls &= unseen;
+  if (hits | walls) {
+    int last = 31 - __builtin_clz(hits | walls);
+    return walls >> last & 1 ? -1 : begin + last;
+  }
+  return -1;
+}
+
+AVX2 int avx2Count(const char * row, int length, const ByteClass & match) {
+  if (length < 32) {
+    return sse2Count(row, length, match);
+  }
+  Avx2Class scan(match, NO_STOP);
+  unsigned hits, walls;
+  int x = 0, count = 0;
+  for (; x + 32 <= length; x += 32) {
+    scan.test(row + x, hits, walls);
+    count += __builtin_popcount(hits);
+  }
+  if (x < length) {
+    scan.test(row + length - 32, hits, walls);
+    count += __builtin_popcount(hits >> (32 - (length - x)));
+  }
+  return count;
+}
+#endif
+
+struct Available {
+  RowScanner scanners[3];
+  int count = 0;
+  RowScanner chosen; // for the game, see below
+
+  Available() {
+    scanners[count++] = {"scalar", scalarRight, scalarLeft, scalarCount};
+#ifdef __SSE2__
+    scanners[count++] = {"sse2", sse2Right, sse2Left, sse2Count};
+#endif
+#ifdef SCAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+      scanners[count++] = {"avx2", avx2Right, avx2Left, avx2Count};
+    }
+#endif
+    // Each operation gets the kernel that wins in pacvim --bench-scan.
+    // Counting points looks at whole rows and is 4x faster with AVX2. The
+    // scans right and left mostly stop at a wall within a few cells; there
+    // the vector kernels don't win at -O2 (0.8x to 1.0x) and lose badly in
+    // the default build (down to 0.4x), so the game keeps them scalar.
+    chosen = {"chosen", scalarRight, scalarLeft, scanners[count - 1].count};
+  }
+};
+
+const Available & available() {
+  static const Available scanners;
+  return scanners;
+}
+
+} // namespace
+
+const RowScanner * rowScanners(int & count) {
+  count = available().count;
+  return available().scanners;
+}
+
+const RowScanner & rowScanner() {
+  return available().chosen;
+}
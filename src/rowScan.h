@@ -0,0 +1,80 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef ROWSCAN_H
+#define ROWSCAN_H
+
+// Kernels for the scans f/t/F/T, %, the reachability map and point counting
+// all do: along one row of the board, find the first byte of a class,
+// unless a wall comes first. Rows are one byte per cell (see scanByte in
+// unicode.h), so the scans can look at 16 (SSE2) or 32 (AVX2) cells at a
+// time. Which kernels the CPU can run is found out once, at run time; the
+// game uses, per operation, the one that measured fastest (rowScanner).
+// The scalar kernel is the fallback and the reference for
+//
+//   pacvim --bench-scan [maps/map1.txt ...]
+//
+// which checks every kernel against it and times them all (see scanBench.h).
+
+// no stop byte: scan to the end of the range, across walls
+const int NO_STOP = -1;
+
+// up to 8 bytes to look for, or (except) to look past
+struct ByteClass {
+  char bytes[8];
+  int count;
+  bool except;
+  bool table[256]; // the same, for the scalar kernel: in the class or not
+
+  explicit ByteClass(char byte);
+  // the bytes of a string literal
+  ByteClass(const char * bytes, bool except);
+
+  bool matches(char c) const { return table[static_cast<unsigned char>(c)]; }
+};
+
+struct RowScanner {
+  const char * name;
+  // the first column from `from` up to end (not included) whose byte is in
+  // the class; -1 if there is none, or if the stop byte comes first
+  int (*right)(const char * row, int from, int end, const ByteClass & match, int stop);
+  // the same, from `from` down to begin (included)
+  int (*left)(const char * row, int from, int begin, const ByteClass & match, int stop);
+  // how many of the first length bytes are in the class
+  int (*count)(const char * row, int length, const ByteClass & match);
+};
+
+// the kernels this CPU can run, scalar first and the widest last
+const RowScanner * rowScanners(int & count);
+// what the game scans with: the widest count, scalar scans right and left
+const RowScanner & rowScanner();
+
+inline int scanRight(const char * row, int from, int end, const ByteClass & match, int stop) {
+  return rowScanner().right(row, from, end, match, stop);
+}
+
+inline int scanLeft(const char * row, int from, int begin, const ByteClass & match, int stop) {
+  return rowScanner().left(row, from, begin, match, stop);
+}
+
+inline int countInClass(const char * row, int length, const ByteClass & match) {
+  return rowScanner().count(row, length, match);
+}
+
+#endif
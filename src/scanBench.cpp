@@ -0,0 +1,227 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "scanBench.h"
+#include "generator.h"
+#include "level.h"
+#include "rowScan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+typedef std::vector<std::string> Rows;
+
+// a class for every byte, so that the scans don't spend their time making them
+const ByteClass & letterClass(char c) {
+  struct Classes {
+    std::vector<ByteClass> of;
+    Classes() {
+      for (int c = 0; c < 256; ++c) {
+        of.emplace_back(static_cast<char>(c));
+      }
+    }
+  };
+  static const Classes classes;
+  return classes.of[static_cast<unsigned char>(c)];
+}
+
+// Every scan goes over all rows once and returns a sum of what it found,
+// which must come out the same for every kernel.
+long findRight(const RowScanner & scanner, const Rows & rows) {
+  long sum = 0;
+  for (const std::string & row : rows) {
+    for (int x = 0; x < static_cast<int>(row.length()); ++x) {
+      if (row[x] != '#') {
+        sum += scanner.right(row.data(), x + 1, row.length(), letterClass(row[x]), '#');
+      }
+    }
+  }
+  return sum;
+}
+
+long findLeft(const RowScanner & scanner, const Rows & rows) {
+  long sum = 0;
+  for (const std::string & row : rows) {
+    for (int x = 0; x < static_cast<int>(row.length()); ++x) {
+      if (row[x] != '#') {
+        sum += scanner.left(row.data(), x - 1, 0, letterClass(row[x]), '#');
+      }
+    }
+  }
+  return sum;
+}
+
+long findBrackets(const RowScanner & scanner, const Rows & rows) {
+  static const ByteClass BRACKETS("({[)}]", false);
+  static const std::string brackets = "({[)}]";
+  static const std::string opposites = ")}]({[";
+  long sum = 0;
+  for (const std::string & row : rows) {
+    int length = row.length();
+    for (int x = 0; x < length; ++x) {
+      int source = scanner.right(row.data(), x, length, BRACKETS, '#');
+      if (source == -1) {
+        continue;
+      }
+      size_t which = brackets.find(row[source]);
+      const ByteClass & partner = letterClass(opposites[which]);
+      sum += which < 3 ? scanner.right(row.data(), source + 1, length, partner, NO_STOP)
+                       : scanner.left(row.data(), source - 1, 0, partner, NO_STOP);
+    }
+  }
+  return sum;
+}
+
+long splitRuns(const RowScanner & scanner, const Rows & rows) {
+  static const ByteClass WALL('#');
+  static const ByteClass OPEN("#", true);
+  static const ByteClass LETTER(" #", true);
+  long sum = 0;
+  for (const std::string & row : rows) {
+    int length = row.length();
+    for (int x = scanner.right(row.data(), 0, length, OPEN, NO_STOP); x != -1;) {
+      int end = scanner.right(row.data(), x, length, WALL, NO_STOP);
+      if (end == -1) {
+        end = length;
+      }
+      bool has_char = scanner.right(row.data(), x, end, LETTER, NO_STOP) != -1;
+      sum += x * 3 + end * 5 + has_char;
+      x = scanner.right(row.data(), end, length, OPEN, NO_STOP);
+    }
+  }
+  return sum;
+}
+
+long countPoints(const RowScanner & scanner, const Rows & rows) {
+  static const ByteClass POINTS(" #~\x80", true);
+  long sum = 0;
+  for (const std::string & row : rows) {
+    sum += scanner.count(row.data(), row.length(), POINTS);
+  }
+  return sum;
+}
+
+struct Scan {
+  const char * name;
+  long (*run)(const RowScanner & scanner, const Rows & rows);
+};
+
+const Scan SCANS[] = {
+  {"f/t", findRight},
+  {"F/T", findLeft},
+  {"%", findBrackets},
+  {"runs", splitRuns},
+  {"points", countPoints},
+};
+
+// the rows of a level as the reachability map has them, a byte per cell
+bool addRows(const std::string & path, Rows & rows) {
+  Level level;
+  if (!loadLevel(path, level)) {
+    return false;
+  }
+  for (int y = 0; y < level.map_end; ++y) {
+    const ArenaString & line = level.reachability.line(y);
+    rows.push_back(std::string(line.begin(), line.end()));
+  }
+  return true;
+}
+
+} // namespace
+
+int runScanBench(const std::vector<std::string> & args) {
+  int rounds = 100;
+  std::vector<std::string> paths;
+  bool ok = true;
+  for (size_t i = 0; i < args.size() && ok; ++i) {
+    if (args[i] == "--rounds" && i + 1 < args.size()) {
+      char * end = nullptr;
+      rounds = strtol(args[++i].c_str(), &end, 10);
+      ok = *end == '\0' && rounds > 0;
+    } else if (args[i].compare(0, 2, "--") == 0) {
+      ok = false;
+    } else {
+      paths.push_back(args[i]);
+    }
+  }
+  if (!ok) {
+    std::cerr << "Usage: pacvim --bench-scan [--rounds N] [maps/map1.txt ...]" << std::endl;
+    return 2;
+  }
+  if (paths.empty()) {
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+      paths.push_back(generatedLevelName(seed, 200, 99));
+    }
+  }
+  Rows rows;
+  size_t longest = 0;
+  for (const std::string & path : paths) {
+    if (!addRows(path, rows)) {
+      std::cerr << path << ": cannot open file" << std::endl;
+      return 1;
+    }
+  }
+  for (const std::string & row : rows) {
+    longest = std::max(longest, row.length());
+  }
+
+  int count;
+  const RowScanner * scanners = rowScanners(count);
+  std::cout << rows.size() << " rows of up to " << longest << " cells from " << paths.size()
+            << " level(s), " << rounds << " rounds; nanoseconds per row" << std::endl;
+  std::cout << std::left << std::setw(8) << "scan" << std::right;
+  for (int k = 0; k < count; ++k) {
+    std::cout << std::setw(k == 0 ? 10 : 18) << scanners[k].name;
+  }
+  std::cout << std::endl << std::fixed << std::setprecision(1);
+  int status = 0;
+  for (const Scan & scan : SCANS) {
+    std::cout << std::left << std::setw(8) << scan.name << std::right;
+    long expected = 0;
+    double scalar_ns = 0;
+    for (int k = 0; k < count; ++k) {
+      long sum = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (int round = 0; round < rounds; ++round) {
+        sum = scan.run(scanners[k], rows);
+      }
+      std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+      double ns = took.count() / (double(rounds) * rows.size());
+      if (k == 0) {
+        expected = sum;
+        scalar_ns = ns;
+        std::cout << std::setw(10) << ns;
+      } else {
+        std::cout << std::setw(10) << ns << " (" << std::setw(4) << scalar_ns / ns << "x)";
+      }
+      if (sum != expected) {
+        std::cerr << scan.name << ": " << scanners[k].name << " finds something other than "
+                  << scanners[0].name << std::endl;
+        status = 1;
+      }
+    }
+    std::cout << std::endl;
+  }
+  return status;
+}
@@ -0,0 +1,47 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef SCANBENCH_H
+#define SCANBENCH_H
+
+// pacvim --bench-scan: times the row scan kernels of rowScan.h on the rows
+// of real levels.
+//
+//   pacvim --bench-scan [--rounds N] [maps/map1.txt ...]
+//
+// Without maps it takes generated levels of the largest size there is
+// (200x99), as endless mode ends up playing. Every kernel this CPU can run
+// does the scans the game does, N times over (100 by default):
+// - f/t: from every cell, the next cell with the same letter, up to a wall
+// - F/T: the same, to the left
+// - %: from every cell, the first bracket up to a wall, then its partner
+//   across walls
+// - runs: the stretches between walls, as the reachability map splits a line
+// - points: the points on the line, as a level counts them
+// and the nanoseconds per row are printed, with how much faster than the
+// scalar kernel that is. Any kernel that finds something other than the
+// scalar one is reported, and makes the exit code 1.
+
+#include <string>
+#include <vector>
+
+// returns the exit code
+int runScanBench(const std::vector<std::string> & args);
+
+#endif
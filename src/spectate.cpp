@@ -0,0 +1,425 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "spectate.h"
+#include "allocCheck.h"
+#include "board.h"
+#include "terminal.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t HEADER_SIZE = 5; // type, payload length
+const size_t KEYS_SHOWN = 16; // on the watcher's key line
+
+void put16(std::string & out, int value) {
+  uint16_t v = value;
+  out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+void put32(std::string & out, uint32_t v) {
+  out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+int get16(const char * in) {
+  uint16_t v;
+  memcpy(&v, in, sizeof(v));
+  return v;
+}
+
+uint32_t get32(const char * in) {
+  uint32_t v;
+  memcpy(&v, in, sizeof(v));
+  return v;
+}
+
+// messages are appended to out; returns where this one starts
+size_t beginMessage(std::string & out, char type) {
+  size_t start = out.size();
+  out.push_back(type);
+  put32(out, 0);
+  return start;
+}
+
+void endMessage(std::string & out, size_t start) {
+  uint32_t length = out.size() - start - HEADER_SIZE;
+  memcpy(&out[start + 1], &length, sizeof(length));
+}
+
+bool unixAddress(const std::string & path, sockaddr_un & addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+} // namespace
+
+bool SpectatorServer::start(const std::string & socket_path) {
+  sockaddr_un addr;
+  if (!unixAddress(socket_path, addr)) {
+    return false;
+  }
+  // a socket left behind by a game that didn't get to clean up; one that
+  // takes connections belongs to a game still serving on it
+  struct stat st;
+  if (lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool in_use = probe != -1
+        && connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    if (probe != -1) {
+      close(probe);
+    }
+    if (in_use) {
+      errno = EADDRINUSE;
+      return false;
+    }
+    unlink(socket_path.c_str());
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    return false;
+  }
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1
+      || listen(fd, 16) == -1
+      || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return false;
+  }
+  listen_fd = fd;
+  path = socket_path;
+  return true;
+}
+
+void SpectatorServer::stop() {
+  if (!serving()) {
+    return;
+  }
+  for (Client & client : clients) {
+    close(client.fd);
+  }
+  clients.clear();
+  close(listen_fd);
+  listen_fd = -1;
+  unlink(path.c_str());
+}
+
+void SpectatorServer::accept_clients() {
+  int fd;
+  while ((fd = accept(listen_fd, nullptr, nullptr)) != -1) {
+    Client client;
+    client.fd = fd;
+    clients.push_back(std::move(client));
+  }
+}
+
+bool SpectatorServer::enqueue(Client & client, const std::string & msg) {
+  // (an empty queue takes anything, or a big keyframe would never fit)
+  if (!client.queue.empty() && client.queued_bytes + msg.size() > MAX_QUEUED_BYTES) {
+    // too far behind to catch up frame by frame: forget what it hasn't
+    // started reading and send the whole board again
+    size_t keep = client.sent > 0 ? 1 : 0;
+    while (client.queue.size() > keep) {
+      client.queued_bytes -= client.queue.back().size();
+      client.queue.pop_back();
+    }
+    client.needs_keyframe = true;
+    return false;
+  }
+  client.queue.push_back(msg);
+  client.queued_bytes += msg.size();
+  return true;
+}
+
+bool SpectatorServer::flush(Client & client) {
+  while (!client.queue.empty()) {
+    const std::string & front = client.queue.front();
+    ssize_t n = send(client.fd, front.data() + client.sent, front.size() - client.sent,
+                     MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client.sent += n;
+    if (client.sent == front.size()) {
+      client.queued_bytes -= front.size();
+      client.queue.pop_front();
+      client.sent = 0;
+    }
+  }
+  return true;
+}
+
+void SpectatorServer::flush_all() {
+  for (size_t i = 0; i < clients.size();) {
+    if (flush(clients[i])) {
+      ++i;
+    } else {
+      close(clients[i].fd);
+      clients.erase(clients.begin() + i);
+    }
+  }
+}
+
+void SpectatorServer::encode_frame(const Board & board, int cursor_x, int cursor_y, bool keyframe) {
+  int width = board.getWidth(), height = board.getHeight();
+  message.clear();
+  size_t start = beginMessage(message, keyframe ? 'K' : 'F');
+  put16(message, width);
+  put16(message, height);
+  put16(message, cursor_x);
+  put16(message, cursor_y);
+  const std::vector<int> & cells = board.lastRendered();
+  put32(message, keyframe ? width * height : cells.size());
+  auto putCell = [&](int x, int y) {
+    Glyph g = board.compose(x, y);
+    put16(message, x);
+    put16(message, y);
+    put32(message, g.letter);
+    message.push_back(static_cast<char>(g.wall));
+    message.push_back(static_cast<char>(g.color));
+  };
+  if (keyframe) {
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        putCell(x, y);
+      }
+    }
+  } else {
+    for (int cell : cells) {
+      putCell(cell % width, cell / width);
+    }
+  }
+  endMessage(message, start);
+  if (keyframe) {
+    // the screen is cleared for a keyframe, so the lines under the board
+    // have to come again
+    start = beginMessage(message, 'H');
+    message += hud;
+    endMessage(message, start);
+  }
+}
+
+void SpectatorServer::publishFrame(const Board & board, int cursor_x, int cursor_y) {
+  if (!serving()) {
+    return;
+  }
+  // every client queues its own copy of the messages (see allocCheck.h)
+  AllocExempt exempt;
+  accept_clients();
+  if (clients.empty()) {
+    return;
+  }
+  // nothing to tell those that are up to date if nothing moved
+  bool changed = !board.lastRendered().empty() || cursor_x != last_cursor_x || cursor_y != last_cursor_y;
+  last_cursor_x = cursor_x;
+  last_cursor_y = cursor_y;
+  bool any_keyframe = false, any_frame = false;
+  for (Client & client : clients) {
+    (client.needs_keyframe ? any_keyframe : any_frame) = true;
+  }
+  any_frame &= changed;
+  if (any_frame) {
+    encode_frame(board, cursor_x, cursor_y, false);
+    for (Client & client : clients) {
+      if (!client.needs_keyframe) {
+        enqueue(client, message);
+      }
+    }
+  }
+  if (any_keyframe) {
+    encode_frame(board, cursor_x, cursor_y, true);
+    for (Client & client : clients) {
+      if (client.needs_keyframe) {
+        client.needs_keyframe = !enqueue(client, message);
+      }
+    }
+  }
+  flush_all();
+}
+
+void SpectatorServer::publishHud(const std::string & text) {
+  if (text == hud) {
+    return;
+  }
+  AllocExempt exempt;
+  hud = text;
+  if (clients.empty()) {
+    return;
+  }
+  message.clear();
+  size_t start = beginMessage(message, 'H');
+  message += hud;
+  endMessage(message, start);
+  for (Client & client : clients) {
+    if (!client.needs_keyframe) {
+      enqueue(client, message);
+    }
+  }
+}
+
+void SpectatorServer::publishKey(const char * name) {
+  if (clients.empty()) {
+    return;
+  }
+  AllocExempt exempt;
+  message.clear();
+  size_t start = beginMessage(message, 'I');
+  message += name;
+  endMessage(message, start);
+  for (Client & client : clients) {
+    if (!client.needs_keyframe) {
+      enqueue(client, message);
+    }
+  }
+}
+
+namespace {
+
+// what --watch knows about the game being watched
+struct WatchedScreen {
+  int width = 0;
+  int height = 0;
+  int cursor_x = 0;
+  int cursor_y = 0;
+  std::vector<std::string> keys; // the last few keys typed
+
+  void frame(const char * in, size_t length, bool keyframe) {
+    if (length < 12) {
+      return;
+    }
+    int new_width = get16(in), new_height = get16(in + 2);
+    cursor_x = get16(in + 4);
+    cursor_y = get16(in + 6);
+    size_t count = get32(in + 8);
+    if (keyframe || new_width != width || new_height != height) {
+      clear();
+    }
+    width = new_width;
+    height = new_height;
+    const size_t CELL_SIZE = 10;
+    in += 12;
+    for (size_t i = 0; i < count && 12 + (i + 1) * CELL_SIZE <= length; ++i, in += CELL_SIZE) {
+      Glyph g;
+      g.letter = get32(in + 4);
+      g.wall = static_cast<Wall>(in[8]);
+      g.color = in[9];
+      drawGlyph(get16(in), get16(in + 2), g);
+    }
+  }
+
+  void hud(const char * in, size_t length) {
+    std::string text(in, length);
+    mvprintw(height + 1, 1, "%s", text.c_str());
+  }
+
+  void key(const char * in, size_t length) {
+    keys.push_back(std::string(in, length));
+    if (keys.size() > KEYS_SHOWN) {
+      keys.erase(keys.begin());
+    }
+    std::string line = "Keys:";
+    for (const std::string & k : keys) {
+      line += " " + k;
+    }
+    mvprintw(height + 5, 1, "%s", line.c_str());
+    clrtoeol();
+  }
+};
+
+} // namespace
+
+int watchGame(const std::string & socket_path) {
+  sockaddr_un addr;
+  int fd = -1;
+  if (unixAddress(socket_path, addr)) {
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd != -1 && connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1) {
+      int saved = errno;
+      close(fd);
+      fd = -1;
+      errno = saved;
+    }
+  }
+  if (fd == -1) {
+    endwin();
+    std::cout << "\nCannot watch " << socket_path << ": " << strerror(errno) << std::endl << std::endl;
+    return 1;
+  }
+  mvprintw(0, 0, "Watching %s, q to stop. Waiting for the next frame...", socket_path.c_str());
+  refresh();
+
+  WatchedScreen screen;
+  std::string buffer;
+  char chunk[1 << 16];
+  bool playing = true;
+  while (playing) {
+    pollfd fds[2] = {{fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    poll(fds, 2, 1000);
+    int key;
+    while ((key = getch()) != ERR) {
+      if (key == 'q') {
+        playing = false;
+      }
+    }
+    if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t n = read(fd, chunk, sizeof(chunk));
+      if (n <= 0) {
+        break; // the game is over
+      }
+      buffer.append(chunk, n);
+    }
+    size_t pos = 0;
+    while (buffer.size() - pos >= HEADER_SIZE) {
+      size_t length = get32(&buffer[pos + 1]);
+      if (buffer.size() - pos - HEADER_SIZE < length) {
+        break;
+      }
+      const char * payload = &buffer[pos + HEADER_SIZE];
+      switch (buffer[pos]) {
+        case 'K': screen.frame(payload, length, true); break;
+        case 'F': screen.frame(payload, length, false); break;
+        case 'H': screen.hud(payload, length); break;
+        case 'I': screen.key(payload, length); break;
+        default: break; // from a newer pacvim; skip it
+      }
+      pos += HEADER_SIZE + length;
+    }
+    buffer.erase(0, pos);
+    move(screen.cursor_y, screen.cursor_x);
+    refresh();
+  }
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,91 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+// Watching somebody play, on the same machine:
+//   pacvim --serve /tmp/pacvim.sock   plays as usual, and publishes every frame
+//   pacvim --watch /tmp/pacvim.sock   shows what is being played
+//
+// The player's process never waits for a spectator. What a spectator hasn't
+// read yet is queued for it, up to MAX_QUEUED_BYTES; a spectator that falls
+// further behind than that has its queue thrown away and gets a keyframe
+// (the whole board) instead of the next frame.
+//
+// Every message is a type byte, a 4 byte payload length and the payload,
+// in the byte order of the machine:
+//   'K' keyframe, 'F' frame: width, height, cursor x, cursor y (2 bytes
+//       each), a 4 byte cell count and per cell x, y (2 bytes each), the
+//       glyph letter (4 bytes, a code point), wall and colour. A keyframe has
+//       every cell.
+//   'H' the lines printed under the board (points, lives)
+//   'I' a key the player typed, as named in the latency report
+
+#include <deque>
+#include <string>
+#include <vector>
+
+class Board;
+
+class SpectatorServer {
+public:
+  static const size_t MAX_QUEUED_BYTES = 1 << 18;
+
+  // listen on a Unix domain socket; false (and errno set) if that failed,
+  // EADDRINUSE if another game is serving on it
+  bool start(const std::string & path);
+  // close every connection and remove the socket
+  void stop();
+  bool serving() const { return listen_fd != -1; }
+
+  // after every Board::render: the cells it drew, and where the cursor is
+  void publishFrame(const Board & board, int cursor_x, int cursor_y);
+  void publishHud(const std::string & text);
+  void publishKey(const char * name);
+
+private:
+  struct Client {
+    int fd;
+    std::deque<std::string> queue; // the front may be partly sent already
+    size_t sent = 0; // of the front message
+    size_t queued_bytes = 0;
+    bool needs_keyframe = true;
+  };
+  int listen_fd = -1;
+  std::string path;
+  std::vector<Client> clients;
+  std::string hud;
+  int last_cursor_x = -1;
+  int last_cursor_y = -1;
+  std::string message; // scratch
+
+  void accept_clients();
+  // false if the client was too far behind; it then waits for a keyframe
+  bool enqueue(Client & client, const std::string & message);
+  // send what the socket takes without blocking; false if the client left
+  bool flush(Client & client);
+  void flush_all();
+  void encode_frame(const Board & board, int cursor_x, int cursor_y, bool keyframe);
+};
+
+// the --watch loop; returns the exit code
+int watchGame(const std::string & path);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+// The screen backend. By default that is curses; `make TERMINAL=ansi`
+// builds against ansiTerminal.h instead, which writes escape sequences
+// itself and needs no curses library at all. Letters outside ASCII are
+// drawn with the wide character calls (setcchar, mvadd_wch), so curses has
+// to be the wide character build, ncursesw.
+
+#ifdef PACVIM_ANSI
+#include "ansiTerminal.h"
+#else
+#ifndef NCURSES_WIDECHAR
+#define NCURSES_WIDECHAR 1
+#endif
+#if __APPLE__ || __FreeBSD__
+#include <curses.h>
+#else
+#include <cstddef>
+#include <ncurses.h>
+#endif
+#endif
+
+#endif
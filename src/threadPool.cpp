@@ -0,0 +1,173 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "threadPool.h"
+#include "allocCheck.h"
+#include <algorithm>
+
+static unsigned participant_count(unsigned threads) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  return threads == 0 ? 1 : threads;
+}
+
+ThreadPool::ThreadPool(unsigned threads) : ranges(participant_count(threads)) {
+  // participant 0 is whoever calls parallel_for, so start one thread less
+  for (unsigned participant = 1; participant < ranges.size(); ++participant) {
+    workers.push_back(std::thread(&ThreadPool::worker_loop, this, participant));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(job_lock);
+    stopping = true;
+  }
+  job_started.notify_all();
+  for (auto & worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::worker_loop(unsigned participant) {
+  unsigned long seen_generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(job_lock);
+      job_started.wait(guard, [&]() { return stopping || job_generation != seen_generation; });
+      if (stopping) {
+        return;
+      }
+      seen_generation = job_generation;
+    }
+    long allocations = allocationCount();
+    run_participant(participant);
+    allocations = allocationCount() - allocations;
+    {
+      std::lock_guard<std::mutex> guard(job_lock);
+      job_allocations += allocations;
+      --busy_workers;
+    }
+    job_finished.notify_one();
+  }
+}
+
+bool ThreadPool::take_chunk(unsigned participant, size_t & begin, size_t & end) {
+  Range & own = ranges[participant];
+  std::lock_guard<std::mutex> guard(own.lock);
+  if (own.begin >= own.end) {
+    return false;
+  }
+  begin = own.begin;
+  end = std::min(own.end, own.begin + job_chunk);
+  own.begin = end;
+  return true;
+}
+
+bool ThreadPool::steal(unsigned participant) {
+  // pick the victim with the most work left; the sizes may change before we
+  // lock it, which only makes the choice a little less than optimal
+  unsigned victim = participant;
+  size_t most_left = 0;
+  for (unsigned other = 0; other < ranges.size(); ++other) {
+    if (other == participant) {
+      continue;
+    }
+    std::lock_guard<std::mutex> guard(ranges[other].lock);
+    size_t left = ranges[other].end - ranges[other].begin;
+    if (ranges[other].begin < ranges[other].end && left > most_left) {
+      most_left = left;
+      victim = other;
+    }
+  }
+  if (victim == participant) {
+    return false;
+  }
+  size_t stolen_begin, stolen_end;
+  {
+    std::lock_guard<std::mutex> guard(ranges[victim].lock);
+    Range & r = ranges[victim];
+    if (r.begin >= r.end) {
+      return true; // emptied in the meantime, look for another victim
+    }
+    size_t middle = r.begin + (r.end - r.begin) / 2;
+    stolen_begin = middle;
+    stolen_end = r.end;
+    r.end = middle;
+  }
+  std::lock_guard<std::mutex> guard(ranges[participant].lock);
+  ranges[participant].begin = stolen_begin;
+  ranges[participant].end = stolen_end;
+  return true;
+}
+
+void ThreadPool::run_participant(unsigned participant) {
+  size_t begin, end;
+  while (true) {
+    while (take_chunk(participant, begin, end)) {
+      for (size_t i = begin; i < end; ++i) {
+        (*job)(i);
+      }
+    }
+    if (!steal(participant)) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> & fn, size_t chunk) {
+  if (count == 0) {
+    return;
+  }
+  if (ranges.size() == 1 || count <= chunk) {
+    // not worth waking anybody up
+    for (size_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  size_t per_participant = count / ranges.size();
+  size_t remainder = count % ranges.size();
+  size_t next = 0;
+  for (unsigned participant = 0; participant < ranges.size(); ++participant) {
+    size_t length = per_participant + (participant < remainder ? 1 : 0);
+    std::lock_guard<std::mutex> guard(ranges[participant].lock);
+    ranges[participant].begin = next;
+    ranges[participant].end = next + length;
+    next += length;
+  }
+  {
+    std::lock_guard<std::mutex> guard(job_lock);
+    job = &fn;
+    job_chunk = chunk == 0 ? 1 : chunk;
+    busy_workers = workers.size();
+    job_allocations = 0;
+    ++job_generation;
+  }
+  job_started.notify_all();
+
+  run_participant(0);
+
+  std::unique_lock<std::mutex> guard(job_lock);
+  job_finished.wait(guard, [&]() { return busy_workers == 0; });
+  job = nullptr;
+  // the caller's allocation checks cover what the job made anywhere
+  addAllocations(job_allocations);
+}
@@ -0,0 +1,75 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small fixed-size pool of worker threads for data-parallel loops.
+//
+// parallel_for splits the index range evenly over the workers (the calling
+// thread is one of them). Each worker eats chunks from the front of its own
+// range; once that is empty it steals the back half of whichever range has
+// the most work left, so uneven work items still keep every core busy.
+class ThreadPool {
+  struct Range {
+    std::mutex lock;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<Range> ranges; // one per participant; [0] is the caller
+
+  std::mutex job_lock;
+  std::condition_variable job_started;
+  std::condition_variable job_finished;
+  const std::function<void(size_t)> * job = nullptr;
+  size_t job_chunk = 1;
+  unsigned long job_generation = 0;
+  unsigned busy_workers = 0;
+  long job_allocations = 0; // by the workers, see allocCheck.h
+  bool stopping = false;
+
+  void worker_loop(unsigned participant);
+  void run_participant(unsigned participant);
+  bool take_chunk(unsigned participant, size_t & begin, size_t & end);
+  bool steal(unsigned participant);
+
+public:
+  // threads == 0 means one participant per hardware thread
+  explicit ThreadPool(unsigned threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  // call fn(i) for every i in [0, count) and return once all calls are done;
+  // only one parallel_for may run on a pool at a time
+  void parallel_for(size_t count, const std::function<void(size_t)> & fn, size_t chunk = 1);
+
+  unsigned size() const { return ranges.size(); }
+};
+
+#endif
@@ -0,0 +1,592 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "tournament.h"
+#include "allocCheck.h"
+#include "avatar.h"
+#include "game.h"
+#include "ghost1.h"
+#include "headless.h"
+#include "level.h"
+#include "mapFile.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <random>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+enum class Outcome : uint8_t { Won, Ghost, Tilde, Timeout };
+
+struct Options {
+  int runs = 100;
+  std::vector<std::string> strategies{"greedy"};
+  std::vector<double> thinks{1.0};
+  double keys_per_second = 8;
+  double max_seconds = 300;
+  unsigned jobs = 0;
+  std::vector<std::string> maps;
+  // --tune only
+  double target = 0.5;
+  bool write = false;
+};
+
+struct Job {
+  size_t map;
+  size_t think;
+  size_t strategy;
+  unsigned seed;
+  double think_multiplier;
+};
+
+// what a worker sends back; small enough to be written to a pipe atomically
+struct Result {
+  uint32_t job;
+  Outcome outcome;
+  uint32_t ticks;
+  uint32_t points;
+};
+
+// A scripted player: the key it presses next, or 0 to let this one pass.
+// Strategies look at the board like a player looks at the screen.
+typedef char (*Strategy)(std::minstd_rand & rng);
+
+char randomKey(std::minstd_rand & rng) {
+  static const char keys[] = "hjklwbe";
+  std::uniform_int_distribution<int> pick(0, sizeof(keys) - 2);
+  return keys[pick(rng)];
+}
+
+// the hjkl key of the first step on a shortest walk to a point that hasn't
+// been eaten, or 0 if there is none. A careful walk keeps off the cells
+// next to ghosts.
+char firstStepToPoint(bool careful) {
+  static const int dx[] = {-1, 0, 0, 1};
+  static const int dy[] = {0, 1, -1, 0};
+  static const char keys[] = "hjkl";
+  static std::vector<signed char> first; // direction of the first step, -1 if unseen
+  static std::vector<int> todo;
+  int width = board.getWidth(), height = board.getHeight();
+  first.assign(width * height, -1);
+  todo.clear();
+  auto safe = [&](int x, int y) {
+    if (!board.isValid(x, y) || board.letter(x, y) == '~' || board.ghostAt(x, y)) {
+      return false;
+    }
+    for (int d = 0; careful && d < 4; ++d) {
+      if (board.ghostAt(x + dx[d], y + dy[d])) {
+        return false;
+      }
+    }
+    return true;
+  };
+  int px = player.getX(), py = player.getY();
+  for (int d = 0; d < 4; ++d) {
+    int x = px + dx[d], y = py + dy[d];
+    if (safe(x, y) && first[y * width + x] == -1) {
+      first[y * width + x] = d;
+      todo.push_back(y * width + x);
+    }
+  }
+  for (size_t next = 0; next < todo.size(); ++next) {
+    int cell = todo[next];
+    int x = cell % width, y = cell / width;
+    if (board.terrainAt(x, y).point && !board.isEaten(x, y)) {
+      return keys[first[cell]];
+    }
+    for (int d = 0; d < 4; ++d) {
+      int nx = x + dx[d], ny = y + dy[d];
+      if (safe(nx, ny) && first[ny * width + nx] == -1 && !(nx == px && ny == py)) {
+        first[ny * width + nx] = first[cell];
+        todo.push_back(ny * width + nx);
+      }
+    }
+  }
+  return 0;
+}
+
+// walks to the nearest point, away from ghosts if it can; with nowhere to
+// go, it waits for the ghosts to move
+char greedyKey(std::minstd_rand &) {
+  char key = firstStepToPoint(true);
+  if (key == 0) {
+    key = firstStepToPoint(false);
+  }
+  return key;
+}
+
+// greedy with a human's reactions: now and then it hesitates for a key
+char sloppyKey(std::minstd_rand & rng) {
+  std::uniform_int_distribution<int> percent(0, 99);
+  return percent(rng) < 30 ? 0 : greedyKey(rng);
+}
+
+struct NamedStrategy {
+  const char * name;
+  Strategy next_key;
+};
+
+const NamedStrategy STRATEGIES[] = {
+  {"greedy", greedyKey},
+  {"random", randomKey},
+  {"sloppy", sloppyKey},
+};
+
+const NamedStrategy * findStrategy(const std::string & name) {
+  for (const NamedStrategy & s : STRATEGIES) {
+    if (name == s.name) {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+// one game, from the start of the level to winning, dying or running out
+// of time
+Result play(const Options & options, const Job & job, uint32_t index) {
+  startHeadlessLevel(options.maps[job.map], job.think_multiplier, job.seed);
+  KeyParser keys;
+  std::minstd_rand rng(job.seed);
+  Strategy strategy = findStrategy(options.strategies[job.strategy])->next_key;
+
+  long ticks_per_key = std::max(1L, std::lround(1.0 / (options.keys_per_second * TICK_SECONDS)));
+  long max_ticks = std::lround(options.max_seconds / TICK_SECONDS);
+  long tick = 0;
+  for (; GAME_WON == 0 && tick < max_ticks; ++tick) {
+    char key = tick % ticks_per_key == 0 ? strategy(rng) : 0;
+    // the strategy plays the player; only the game itself must not allocate
+    AllocCheck check("a --tournament tick");
+    if (key != 0) {
+      doKeystroke(player, keys.feed(key));
+    }
+    headlessTick(tick);
+  }
+  ghosts.clear();
+
+  Result result;
+  result.job = index;
+  result.ticks = tick;
+  result.points = player.getPoints();
+  if (GAME_WON == 1) {
+    result.outcome = Outcome::Won;
+  } else if (GAME_WON == 0) {
+    result.outcome = Outcome::Timeout;
+  } else {
+    result.outcome = DEATH_CAUSE == Death::Tilde ? Outcome::Tilde : Outcome::Ghost;
+  }
+  return result;
+}
+
+bool parseList(const std::string & text, std::vector<std::string> & items) {
+  items.clear();
+  std::stringstream in(text);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    if (item.empty()) {
+      return false;
+    }
+    items.push_back(item);
+  }
+  return !items.empty();
+}
+
+bool parseNumber(const std::string & text, double & number) {
+  char * end = nullptr;
+  number = strtod(text.c_str(), &end);
+  return !text.empty() && *end == '\0' && number > 0;
+}
+
+bool parseOptions(const std::vector<std::string> & args, bool tuning, Options & options) {
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string & arg = args[i];
+    bool has_value = i + 1 < args.size();
+    double number;
+    std::vector<std::string> items;
+    if (arg.compare(0, 2, "--") != 0) {
+      options.maps.push_back(arg);
+    } else if (tuning && arg == "--write") {
+      options.write = true;
+    } else if (!has_value) {
+      std::cerr << arg << " needs a value" << std::endl;
+      return false;
+    } else if (arg == "--runs" && parseNumber(args[++i], number)) {
+      options.runs = number;
+    } else if (arg == "--jobs" && parseNumber(args[++i], number)) {
+      options.jobs = number;
+    } else if (arg == "--keys-per-second" && parseNumber(args[++i], number)) {
+      options.keys_per_second = number;
+    } else if (arg == "--max-seconds" && parseNumber(args[++i], number)) {
+      options.max_seconds = number;
+    } else if (arg == "--strategy" && parseList(args[++i], options.strategies)) {
+      for (const std::string & name : options.strategies) {
+        if (!findStrategy(name)) {
+          std::cerr << "unknown strategy " << name << std::endl;
+          return false;
+        }
+      }
+    } else if (tuning && arg == "--target" && parseNumber(args[++i], number) && number < 1) {
+      options.target = number;
+    } else if (arg == "--think" && parseList(args[++i], items)) {
+      options.thinks.clear();
+      for (const std::string & item : items) {
+        if (!parseNumber(item, number)) {
+          std::cerr << "bad think multiplier " << item << std::endl;
+          return false;
+        }
+        options.thinks.push_back(number);
+      }
+    } else {
+      // an unknown option, or a known one with a bad value
+      std::cerr << "bad option " << arg << (args[i] != arg ? " " + args[i] : "") << std::endl;
+      return false;
+    }
+  }
+  return !options.maps.empty();
+}
+
+// run the jobs striped over the workers; results come back in any order
+bool runWorkers(const Options & options, const std::vector<Job> & jobs, std::vector<Result> & results) {
+  unsigned workers = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+  workers = std::min<size_t>(workers, jobs.size());
+  std::vector<int> pipes;
+  std::vector<pid_t> children;
+  for (unsigned w = 0; w < workers; ++w) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+      std::cerr << "pipe: " << strerror(errno) << std::endl;
+      return false;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      std::cerr << "fork: " << strerror(errno) << std::endl;
+      return false;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      for (int fd : pipes) {
+        close(fd);
+      }
+      GHOST_THREADS = 1; // the cores are taken by the other workers
+      for (size_t j = w; j < jobs.size(); j += workers) {
+        Result result = play(options, jobs[j], j);
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result)) {
+          _exit(1);
+        }
+      }
+      _exit(0);
+    }
+    close(fds[1]);
+    pipes.push_back(fds[0]);
+    children.push_back(pid);
+  }
+
+  std::vector<pollfd> open;
+  for (int fd : pipes) {
+    open.push_back(pollfd{fd, POLLIN, 0});
+  }
+  while (!open.empty()) {
+    poll(open.data(), open.size(), -1);
+    for (size_t i = 0; i < open.size();) {
+      Result result;
+      ssize_t n = 0;
+      if (open[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        n = read(open[i].fd, &result, sizeof(result));
+        if (n == sizeof(result)) {
+          results.push_back(result);
+        }
+      }
+      if (n < 0 || (n == 0 && open[i].revents)) {
+        close(open[i].fd);
+        open.erase(open.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+  }
+  bool ok = true;
+  for (pid_t pid : children) {
+    int status;
+    waitpid(pid, &status, 0);
+    ok &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  return ok && results.size() == jobs.size();
+}
+
+struct Totals {
+  int runs = 0;
+  int won = 0;
+  long won_ticks = 0;
+  int ghost = 0;
+  int tilde = 0;
+  int timeout = 0;
+  long points = 0;
+};
+
+void report(const Options & options, const std::vector<Job> & jobs, const std::vector<Result> & results,
+            const std::vector<int> & total_points) {
+  size_t combinations = options.maps.size() * options.thinks.size() * options.strategies.size();
+  std::vector<Totals> totals(combinations);
+  for (const Result & r : results) {
+    const Job & job = jobs[r.job];
+    Totals & t = totals[(job.map * options.thinks.size() + job.think) * options.strategies.size() + job.strategy];
+    t.runs++;
+    t.points += r.points;
+    switch (r.outcome) {
+      case Outcome::Won: t.won++; t.won_ticks += r.ticks; break;
+      case Outcome::Ghost: t.ghost++; break;
+      case Outcome::Tilde: t.tilde++; break;
+      case Outcome::Timeout: t.timeout++; break;
+    }
+  }
+  size_t map_width = 3;
+  for (const std::string & map : options.maps) {
+    map_width = std::max(map_width, map.size());
+  }
+  std::cout << std::left << std::setw(map_width) << "map" << std::right
+            << std::setw(7) << "think" << std::setw(10) << "strategy" << std::setw(7) << "runs"
+            << std::setw(8) << "won" << std::setw(10) << "win secs" << std::setw(8) << "ghost"
+            << std::setw(6) << "~" << std::setw(9) << "timeout" << std::setw(8) << "eaten" << std::endl;
+  std::cout << std::fixed;
+  for (size_t m = 0; m < options.maps.size(); ++m) {
+    for (size_t k = 0; k < options.thinks.size(); ++k) {
+      for (size_t s = 0; s < options.strategies.size(); ++s) {
+        const Totals & t = totals[(m * options.thinks.size() + k) * options.strategies.size() + s];
+        std::cout << std::left << std::setw(map_width) << options.maps[m] << std::right
+                  << std::setw(7) << std::setprecision(2) << options.thinks[k]
+                  << std::setw(10) << options.strategies[s] << std::setw(7) << t.runs
+                  << std::setw(7) << std::setprecision(1) << 100.0 * t.won / t.runs << "%";
+        if (t.won > 0) {
+          std::cout << std::setw(10) << t.won_ticks * TICK_SECONDS / t.won;
+        } else {
+          std::cout << std::setw(10) << "-";
+        }
+        double eaten = total_points[m] ? 100.0 * t.points / (double(t.runs) * total_points[m]) : 0;
+        std::cout << std::setw(8) << t.ghost << std::setw(6) << t.tilde << std::setw(9) << t.timeout
+                  << std::setw(7) << eaten << "%" << std::endl;
+      }
+    }
+  }
+}
+
+// the win rate of the first strategy on every map, with the ghosts of map m
+// as slow as think multiplier multipliers[m]; negative if a worker failed.
+// Every call plays the same seeds, so the ghost dice are the same for every
+// multiplier tried and only the multiplier makes the win rates differ.
+std::vector<double> winRates(const Options & options, const std::vector<double> & multipliers) {
+  std::vector<Job> jobs;
+  for (size_t m = 0; m < options.maps.size(); ++m) {
+    for (int run = 0; run < options.runs; ++run) {
+      jobs.push_back(Job{m, 0, 0, static_cast<unsigned>(run + 1), multipliers[m]});
+    }
+  }
+  std::vector<Result> results;
+  std::vector<double> rates(options.maps.size(), 0);
+  if (!runWorkers(options, jobs, results)) {
+    std::cerr << "a worker failed; " << results.size() << " of " << jobs.size() << " games finished" << std::endl;
+    rates.assign(options.maps.size(), -1);
+    return rates;
+  }
+  for (const Result & r : results) {
+    if (r.outcome == Outcome::Won) {
+      rates[jobs[r.job].map] += 1.0 / options.runs;
+    }
+  }
+  return rates;
+}
+
+// a think time as the maps write them: .7, 1.5
+std::string formatThink(double think) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(2) << std::max(think, 0.01);
+  std::string text = out.str();
+  text.erase(text.find_last_not_of('0') + 1);
+  if (text.back() == '.') {
+    text.pop_back();
+  }
+  if (text.compare(0, 2, "0.") == 0) {
+    text.erase(0, 1);
+  }
+  return text;
+}
+
+// the ghost lines of the map with every think time times scale, padded
+// to the width of the line they replace
+std::vector<std::string> scaledGhostLines(const MapFile & map, const std::vector<std::string> & lines,
+                                          double scale) {
+  std::vector<std::string> scaled;
+  for (const GhostLine & ghost : map.ghosts) {
+    std::string line = ghost.species_id + formatThink(ghost.think * scale) + " "
+                       + std::to_string(ghost.x) + " " + std::to_string(ghost.y);
+    const std::string & old_line = lines[ghost.line_number];
+    if (line.size() < old_line.size()) {
+      line.resize(old_line.size(), ' ');
+    }
+    scaled.push_back(line);
+  }
+  return scaled;
+}
+
+bool readLines(const std::string & path, std::vector<std::string> & lines) {
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return !in.bad() && in.eof();
+}
+
+// write the new ghost lines into the map file, through a temporary file so
+// that a failed write leaves the map as it was
+bool rewriteGhostLines(const std::string & path, const MapFile & map, std::vector<std::string> lines,
+                       const std::vector<std::string> & ghost_lines) {
+  for (size_t g = 0; g < map.ghosts.size(); ++g) {
+    lines[map.ghosts[g].line_number] = ghost_lines[g];
+  }
+  std::string temporary = path + ".tune";
+  {
+    std::ofstream out(temporary);
+    for (const std::string & line : lines) {
+      out << line << "\n";
+    }
+    if (!out.flush()) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+} // namespace
+
+int runTune(const std::vector<std::string> & args) {
+  Options options;
+  // greedy wins all of the seeds or none of them; a player that hesitates
+  // now and then loses some, so the win rate moves smoothly
+  options.strategies = {"sloppy"};
+  if (!parseOptions(args, true, options) || options.strategies.size() != 1 || options.thinks.size() != 1) {
+    std::cerr << "Usage: pacvim --tune [--target RATE] [--think M] [--strategy S] [--runs N] [--write]\n"
+              << "       [--keys-per-second K] [--max-seconds S] [--jobs J] maps/map1.txt ..." << std::endl;
+    return 2;
+  }
+  std::vector<MapFile> maps(options.maps.size());
+  std::vector<std::vector<std::string>> lines(options.maps.size());
+  for (size_t m = 0; m < options.maps.size(); ++m) {
+    if (!loadMapFile(options.maps[m], maps[m]) || !readLines(options.maps[m], lines[m])) {
+      std::cerr << options.maps[m] << ": cannot open file" << std::endl;
+      return 2;
+    }
+  }
+
+  // Bisect the factor the think times are scaled by, per map: slower
+  // ghosts (a larger factor) are easier. All maps take their steps at the
+  // same time so that every step keeps all the workers busy.
+  const int STEPS = 8;
+  const double think = options.thinks[0];
+  std::vector<double> low(maps.size(), 1.0 / 8), high(maps.size(), 8.0);
+  std::vector<double> scale(maps.size(), 1.0), multipliers(maps.size(), think);
+  std::vector<double> start_rate = winRates(options, multipliers);
+  if (start_rate[0] < 0) {
+    return 1;
+  }
+  std::vector<double> best_rate = start_rate;
+  for (int step = 0; step < STEPS; ++step) {
+    std::vector<double> tried(maps.size());
+    for (size_t m = 0; m < maps.size(); ++m) {
+      tried[m] = std::sqrt(low[m] * high[m]);
+      multipliers[m] = think * tried[m];
+    }
+    std::vector<double> rates = winRates(options, multipliers);
+    if (rates[0] < 0) {
+      return 1;
+    }
+    for (size_t m = 0; m < maps.size(); ++m) {
+      if (std::fabs(rates[m] - options.target) < std::fabs(best_rate[m] - options.target)) {
+        best_rate[m] = rates[m];
+        scale[m] = tried[m];
+      }
+      (rates[m] < options.target ? low[m] : high[m]) = tried[m];
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(1);
+  int status = 0;
+  for (size_t m = 0; m < maps.size(); ++m) {
+    std::vector<std::string> ghost_lines = scaledGhostLines(maps[m], lines[m], scale[m]);
+    std::cout << options.maps[m] << ": won " << 100 * start_rate[m] << "%, " << 100 * best_rate[m]
+              << "% with the think times x" << std::setprecision(2) << scale[m] << std::setprecision(1)
+              << std::endl;
+    for (const std::string & line : ghost_lines) {
+      std::cout << "  " << line << std::endl;
+    }
+    if (options.write && !maps[m].ghosts.empty()
+        && !rewriteGhostLines(options.maps[m], maps[m], lines[m], ghost_lines)) {
+      std::cerr << options.maps[m] << ": cannot write file" << std::endl;
+      status = 1;
+    }
+  }
+  return status;
+}
+
+int runTournament(const std::vector<std::string> & args) {
+  Options options;
+  if (!parseOptions(args, false, options)) {
+    std::cerr << "Usage: pacvim --tournament [--runs N] [--strategy greedy,random,sloppy] [--think 1.0,1.2]\n"
+              << "       [--keys-per-second K] [--max-seconds S] [--jobs J] maps/map1.txt ..." << std::endl;
+    return 2;
+  }
+  std::vector<int> total_points;
+  for (const std::string & path : options.maps) {
+    Level checked;
+    if (!loadLevel(path, checked)) {
+      std::cerr << path << ": cannot open file" << std::endl;
+      return 2;
+    }
+    total_points.push_back(checked.total_points);
+  }
+
+  std::vector<Job> jobs;
+  for (size_t m = 0; m < options.maps.size(); ++m) {
+    for (size_t k = 0; k < options.thinks.size(); ++k) {
+      for (size_t s = 0; s < options.strategies.size(); ++s) {
+        for (int run = 0; run < options.runs; ++run) {
+          jobs.push_back(Job{m, k, s, static_cast<unsigned>(run + 1), options.thinks[k]});
+        }
+      }
+    }
+  }
+  std::vector<Result> results;
+  if (!runWorkers(options, jobs, results)) {
+    std::cerr << "a worker failed; " << results.size() << " of " << jobs.size() << " games finished" << std::endl;
+    return 1;
+  }
+  report(options, jobs, results, total_points);
+  return 0;
+}
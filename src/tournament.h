@@ -0,0 +1,59 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+// pacvim --tournament: scripted players play many games, with no terminal
+// and on a simulated clock, to see how hard maps are.
+//
+//   pacvim --tournament [--runs N] [--strategy greedy,random,sloppy]
+//                       [--think 1.0,1.2] [--keys-per-second K]
+//                       [--max-seconds S] [--jobs J] maps/map1.txt ...
+//
+// Every combination of map, think multiplier (how slow the ghosts are, as
+// with the n and h modes) and strategy is played N times, with seeds 1 to
+// N, so every combination sees the same ghost dice. The report has, per
+// combination, the win rate, how long winning took, and what killed the
+// player in the games that were lost.
+//
+// The game keeps its state in globals, so the runs are spread over J
+// worker processes (one per core by default) rather than threads.
+//
+// pacvim --tune: finds, per map, how much slower or faster its ghosts must
+// be for the strategy to win RATE of the games at think multiplier M, and
+// with --write puts the new think times in the ghost lines of the map.
+//
+//   pacvim --tune [--target RATE] [--think M] [--strategy S] [--runs N]
+//                 [--write] [--keys-per-second K] [--max-seconds S]
+//                 [--jobs J] maps/map1.txt ...
+//
+// All ghosts of a map are scaled by the same factor, so the map keeps its
+// fast and slow ghosts; the factor is found by bisection, playing the same
+// N seeds for every factor tried. RATE is 0.5, M 1.0 and S sloppy by
+// default.
+
+#include <string>
+#include <vector>
+
+// returns the exit code
+int runTournament(const std::vector<std::string> & args);
+int runTune(const std::vector<std::string> & args);
+
+#endif
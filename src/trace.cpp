@@ -0,0 +1,117 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "trace.h"
+#include "helperFns.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+bool TRACING = false;
+
+namespace {
+
+struct TraceEvent {
+  const char * name;
+  double begin; // microseconds
+  double end;
+};
+
+// more than this per thread is dropped rather than eating all memory
+const size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+struct ThreadBuffer {
+  int tid;
+  std::vector<TraceEvent> events;
+  size_t dropped = 0;
+};
+
+std::string trace_file;
+std::chrono::steady_clock::time_point trace_start;
+// buffers outlive their threads, the pool's workers never say goodbye
+std::mutex buffers_lock;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+ThreadBuffer & threadBuffer() {
+  thread_local ThreadBuffer * buffer = nullptr;
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> guard(buffers_lock);
+    buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer));
+    buffer = buffers.back().get();
+    buffer->tid = buffers.size();
+    buffer->events.reserve(4096);
+  }
+  return *buffer;
+}
+
+} // namespace
+
+void startTrace(const std::string & file) {
+  trace_file = file;
+  trace_start = std::chrono::steady_clock::now();
+  TRACING = true;
+}
+
+double TraceSpan::now() {
+  std::chrono::duration<double, std::micro> since_start = std::chrono::steady_clock::now() - trace_start;
+  return since_start.count();
+}
+
+void TraceSpan::record(const char * name, double begin, double end) {
+  ThreadBuffer & buffer = threadBuffer();
+  if (buffer.events.size() >= MAX_EVENTS_PER_THREAD) {
+    ++buffer.dropped;
+    return;
+  }
+  TraceEvent event = { name, begin, end };
+  buffer.events.push_back(event);
+}
+
+void writeTrace() {
+  if (!TRACING) {
+    return;
+  }
+  TRACING = false;
+  std::ofstream out(trace_file.c_str());
+  if (!out) {
+    writeError("Cannot write trace to " + trace_file);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(buffers_lock);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  out.setf(std::ios::fixed);
+  out.precision(3);
+  for (auto & buffer : buffers) {
+    for (const TraceEvent & event : buffer->events) {
+      out << (first ? "\n" : ",\n");
+      first = false;
+      out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+          << ",\"ts\":" << event.begin << ",\"dur\":" << event.end - event.begin << "}";
+    }
+    if (buffer->dropped > 0) {
+      writeError("Trace buffer of thread " + std::to_string(buffer->tid) + " was full, dropped "
+                 + std::to_string(buffer->dropped) + " spans");
+    }
+  }
+  out << "\n]}\n";
+}
@@ -0,0 +1,57 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// pacvim --trace out.json records where the time goes as trace event JSON,
+// which chrome://tracing and Perfetto can open. Every thread writes its
+// spans into its own buffer, so tracing takes no locks while the game
+// runs; the buffers are only merged when the file is written at exit.
+// When tracing is off, a span costs one test of a global bool.
+
+#include <string>
+
+extern bool TRACING;
+
+void startTrace(const std::string & file);
+// writes everything recorded so far; does nothing unless tracing
+void writeTrace();
+
+// times the enclosing scope; name must be a string literal (or live as long)
+class TraceSpan {
+  const char * name;
+  double start;
+
+public:
+  explicit TraceSpan(const char * n) : name(n), start(TRACING ? now() : 0) {}
+  ~TraceSpan() {
+    if (TRACING) {
+      record(name, start, now());
+    }
+  }
+  static double now(); // microseconds since the trace started
+  static void record(const char * name, double begin, double end);
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,300 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "unicode.h"
+
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+template <class T>
+struct Range {
+  char32_t first, last;
+  T value;
+};
+
+// the value of the range c is in, or otherwise if it is in none; ranges
+// must be sorted and must not overlap
+template <class T, size_t N>
+T lookup(const Range<T> (&ranges)[N], char32_t c, T otherwise) {
+  const Range<T> * range = std::upper_bound(ranges, ranges + N, c,
+                                            [](char32_t value, const Range<T> & r) { return value < r.first; });
+  if (range == ranges || c > (range - 1)->last) {
+    return otherwise;
+  }
+  return (range - 1)->value;
+}
+
+// combining marks, joiners and other characters that take no column
+const Range<int> ZERO_WIDTH[] = {
+  {0x0300, 0x036F, 0}, {0x0483, 0x0489, 0}, {0x0591, 0x05BD, 0}, {0x05BF, 0x05BF, 0},
+  {0x05C1, 0x05C2, 0}, {0x05C4, 0x05C5, 0}, {0x05C7, 0x05C7, 0}, {0x0610, 0x061A, 0},
+  {0x064B, 0x065F, 0}, {0x0670, 0x0670, 0}, {0x06D6, 0x06DC, 0}, {0x06DF, 0x06E4, 0},
+  {0x06E7, 0x06E8, 0}, {0x06EA, 0x06ED, 0}, {0x0711, 0x0711, 0}, {0x0730, 0x074A, 0},
+  {0x07A6, 0x07B0, 0}, {0x0901, 0x0902, 0}, {0x093C, 0x093C, 0}, {0x0941, 0x0948, 0},
+  {0x094D, 0x094D, 0}, {0x0951, 0x0954, 0}, {0x0962, 0x0963, 0}, {0x0E31, 0x0E31, 0},
+  {0x0E34, 0x0E3A, 0}, {0x0E47, 0x0E4E, 0}, {0x1160, 0x11FF, 0}, {0x1AB0, 0x1AFF, 0},
+  {0x1DC0, 0x1DFF, 0}, {0x200B, 0x200F, 0}, {0x202A, 0x202E, 0}, {0x2060, 0x2064, 0},
+  {0x20D0, 0x20FF, 0}, {0xFE00, 0xFE0F, 0}, {0xFE20, 0xFE2F, 0}, {0xFEFF, 0xFEFF, 0},
+  {0x1D167, 0x1D169, 0}, {0xE0001, 0xE0001, 0}, {0xE0020, 0xE007F, 0}, {0xE0100, 0xE01EF, 0},
+};
+
+// East Asian wide and fullwidth characters, and the emoji terminals draw
+// two columns wide
+const Range<int> WIDE[] = {
+  {0x1100, 0x115F, 2}, {0x231A, 0x231B, 2}, {0x2329, 0x232A, 2}, {0x23E9, 0x23EC, 2},
+  {0x23F0, 0x23F0, 2}, {0x23F3, 0x23F3, 2}, {0x25FD, 0x25FE, 2}, {0x2614, 0x2615, 2},
+  {0x2648, 0x2653, 2}, {0x267F, 0x267F, 2}, {0x2693, 0x2693, 2}, {0x26A1, 0x26A1, 2},
+  {0x26AA, 0x26AB, 2}, {0x26BD, 0x26BE, 2}, {0x26C4, 0x26C5, 2}, {0x26CE, 0x26CE, 2},
+  {0x26D4, 0x26D4, 2}, {0x26EA, 0x26EA, 2}, {0x26F2, 0x26F3, 2}, {0x26F5, 0x26F5, 2},
+  {0x26FA, 0x26FA, 2}, {0x26FD, 0x26FD, 2}, {0x2705, 0x2705, 2}, {0x270A, 0x270B, 2},
+  {0x2728, 0x2728, 2}, {0x274C, 0x274C, 2}, {0x274E, 0x274E, 2}, {0x2753, 0x2755, 2},
+  {0x2757, 0x2757, 2}, {0x2795, 0x2797, 2}, {0x27B0, 0x27B0, 2}, {0x27BF, 0x27BF, 2},
+  {0x2B1B, 0x2B1C, 2}, {0x2B50, 0x2B50, 2}, {0x2B55, 0x2B55, 2}, {0x2E80, 0x303E, 2},
+  {0x3041, 0x33FF, 2}, {0x3400, 0x4DBF, 2}, {0x4E00, 0x9FFF, 2}, {0xA000, 0xA4CF, 2},
+  {0xA960, 0xA97F, 2}, {0xAC00, 0xD7A3, 2}, {0xF900, 0xFAFF, 2}, {0xFE10, 0xFE19, 2},
+  {0xFE30, 0xFE6F, 2}, {0xFF00, 0xFF60, 2}, {0xFFE0, 0xFFE6, 2}, {0x16FE0, 0x16FE4, 2},
+  {0x17000, 0x18AFF, 2}, {0x1B000, 0x1B2FF, 2}, {0x1F004, 0x1F004, 2}, {0x1F0CF, 0x1F0CF, 2},
+  {0x1F18E, 0x1F18E, 2}, {0x1F191, 0x1F19A, 2}, {0x1F200, 0x1F251, 2}, {0x1F300, 0x1F320, 2},
+  {0x1F32D, 0x1F335, 2}, {0x1F337, 0x1F37C, 2}, {0x1F37E, 0x1F393, 2}, {0x1F3A0, 0x1F3CA, 2},
+  {0x1F3CF, 0x1F3D3, 2}, {0x1F3E0, 0x1F3F0, 2}, {0x1F3F4, 0x1F3F4, 2}, {0x1F3F8, 0x1F43E, 2},
+  {0x1F440, 0x1F440, 2}, {0x1F442, 0x1F4FC, 2}, {0x1F4FF, 0x1F53D, 2}, {0x1F54B, 0x1F54E, 2},
+  {0x1F550, 0x1F567, 2}, {0x1F57A, 0x1F57A, 2}, {0x1F595, 0x1F596, 2}, {0x1F5A4, 0x1F5A4, 2},
+  {0x1F5FB, 0x1F64F, 2}, {0x1F680, 0x1F6C5, 2}, {0x1F6CC, 0x1F6CC, 2}, {0x1F6D0, 0x1F6D2, 2},
+  {0x1F6D5, 0x1F6D7, 2}, {0x1F6EB, 0x1F6EC, 2}, {0x1F6F4, 0x1F6FC, 2}, {0x1F7E0, 0x1F7EB, 2},
+  {0x1F90C, 0x1F93A, 2}, {0x1F93C, 0x1F945, 2}, {0x1F947, 0x1F9FF, 2}, {0x1FA70, 0x1FAFF, 2},
+  {0x20000, 0x2FFFD, 2}, {0x30000, 0x3FFFD, 2},
+};
+
+// after vim's classes (utf_class); anything in none of these is a word
+const CharClass P = CharClass::Punctuation;
+const CharClass B = CharClass::Blank;
+const Range<CharClass> CLASSES[] = {
+  {0x00A0, 0x00A0, B}, {0x00A1, 0x00BF, P}, {0x00D7, 0x00D7, P}, {0x00F7, 0x00F7, P},
+  {0x037E, 0x037E, P}, {0x0387, 0x0387, P}, {0x055A, 0x055F, P}, {0x0589, 0x0589, P},
+  {0x05BE, 0x05BE, P}, {0x05C0, 0x05C0, P}, {0x05C3, 0x05C3, P}, {0x05F3, 0x05F4, P},
+  {0x060C, 0x060C, P}, {0x061B, 0x061B, P}, {0x061F, 0x061F, P}, {0x066A, 0x066D, P},
+  {0x06D4, 0x06D4, P}, {0x0700, 0x070D, P}, {0x0964, 0x0965, P}, {0x0970, 0x0970, P},
+  {0x0DF4, 0x0DF4, P}, {0x0E4F, 0x0E4F, P}, {0x0E5A, 0x0E5B, P}, {0x0F04, 0x0F12, P},
+  {0x0F3A, 0x0F3D, P}, {0x0F85, 0x0F85, P}, {0x104A, 0x104F, P}, {0x10FB, 0x10FB, P},
+  {0x1361, 0x1368, P}, {0x166D, 0x166E, P}, {0x1680, 0x1680, B}, {0x169B, 0x169C, P},
+  {0x16EB, 0x16ED, P}, {0x1735, 0x1736, P}, {0x17D4, 0x17DC, P}, {0x1800, 0x180A, P},
+  {0x2000, 0x200B, B}, {0x200C, 0x2027, P}, {0x2028, 0x2029, B}, {0x202A, 0x202E, P},
+  {0x202F, 0x202F, B}, {0x2030, 0x205E, P}, {0x205F, 0x205F, B},
+  {0x2060, 0x27FF, P}, // symbols, arrows, box drawing, dingbats
+  {0x2800, 0x28FF, CharClass::Braille}, {0x2900, 0x2998, P}, {0x29D8, 0x29DB, P},
+  {0x29FC, 0x29FD, P}, {0x2E00, 0x2E7F, P}, {0x3000, 0x3000, B}, {0x3001, 0x3020, P},
+  {0x3030, 0x3030, P}, {0x303D, 0x303D, P}, {0x3040, 0x309F, CharClass::Hiragana},
+  {0x30A0, 0x30FF, CharClass::Katakana}, {0x3300, 0x9FFF, CharClass::Ideograph},
+  {0xAC00, 0xD7A3, CharClass::Hangul}, {0xF900, 0xFAFF, CharClass::Ideograph},
+  {0xFD3E, 0xFD3F, P}, {0xFE30, 0xFE6B, P}, {0xFF00, 0xFF0F, P}, {0xFF1A, 0xFF20, P},
+  {0xFF3B, 0xFF40, P}, {0xFF5B, 0xFF65, P}, {0x1D000, 0x1D24F, P}, {0x1D400, 0x1D7FF, P},
+  {0x1F000, 0x1FAFF, CharClass::Emoji}, {0x20000, 0x2FFFF, CharClass::Ideograph},
+};
+
+struct AsciiClasses {
+  CharClass of[128];
+
+  AsciiClasses() {
+    for (int c = 0; c < 128; ++c) {
+      bool alnum = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+      of[c] = c == ' ' ? CharClass::Blank : alnum ? CharClass::Word : CharClass::Punctuation;
+    }
+  }
+};
+
+const AsciiClasses ASCII_CLASSES;
+
+// copy the ASCII start of the line to out, one byte per cell, and return
+// how long it is
+size_t widenAscii(const unsigned char * in, size_t length, char32_t * out) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= length; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    if (_mm_movemask_epi8(bytes) != 0) {
+      break; // a byte with the high bit set
+    }
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    __m128i * to = reinterpret_cast<__m128i *>(out + i);
+    _mm_storeu_si128(to, _mm_unpacklo_epi16(low, zero));
+    _mm_storeu_si128(to + 1, _mm_unpackhi_epi16(low, zero));
+    _mm_storeu_si128(to + 2, _mm_unpacklo_epi16(high, zero));
+    _mm_storeu_si128(to + 3, _mm_unpackhi_epi16(high, zero));
+  }
+#endif
+  for (; i < length && in[i] < 0x80; ++i) {
+    out[i] = in[i];
+  }
+  return i;
+}
+
+// the code point the bytes at in start with, and how many bytes it takes;
+// 0 if they aren't valid UTF-8
+size_t decodeOne(const unsigned char * in, size_t length, char32_t & c) {
+  size_t size;
+  char32_t smallest; // anything below is an overlong encoding
+  if (in[0] >= 0xC2 && in[0] <= 0xDF) {
+    size = 2;
+    c = in[0] & 0x1F;
+    smallest = 0x80;
+  } else if (in[0] >= 0xE0 && in[0] <= 0xEF) {
+    size = 3;
+    c = in[0] & 0x0F;
+    smallest = 0x800;
+  } else if (in[0] >= 0xF0 && in[0] <= 0xF4) {
+    size = 4;
+    c = in[0] & 0x07;
+    smallest = 0x10000;
+  } else {
+    return 0;
+  }
+  if (length < size) {
+    return 0;
+  }
+  for (size_t i = 1; i < size; ++i) {
+    if ((in[i] & 0xC0) != 0x80) {
+      return 0;
+    }
+    c = c << 6 | (in[i] & 0x3F);
+  }
+  if (c < smallest || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+    return 0;
+  }
+  return size;
+}
+
+} // namespace
+
+unsigned decodeCells(const std::string & line, std::u32string & cells) {
+  size_t length = line.length();
+  // never more cells than bytes: wide characters take at least 3 bytes
+  cells.resize(length);
+  const unsigned char * in = reinterpret_cast<const unsigned char *>(line.data());
+  char32_t * out = &cells[0];
+  size_t i = widenAscii(in, length, out);
+  size_t used = i;
+  unsigned changes = 0;
+  while (i < length) {
+    if (in[i] < 0x80) {
+      out[used++] = in[i++];
+      continue;
+    }
+    char32_t c;
+    size_t size = decodeOne(in + i, length - i, c);
+    if (size == 0 || c < 0xA0) {
+      // C1 control characters are valid UTF-8, but not text
+      c = REPLACEMENT_CHARACTER;
+      size = size == 0 ? 1 : size;
+      changes |= INVALID_UTF8;
+    }
+    i += size;
+    int width = displayWidth(c);
+    if (width == 0) {
+      changes |= DROPPED_ZERO_WIDTH;
+      continue;
+    }
+    out[used++] = c;
+    if (width == 2) {
+      out[used++] = WIDE_TAIL;
+    }
+  }
+  cells.resize(used);
+  return changes;
+}
+
+char scanByte(char32_t c) {
+  if (c < 0x80) {
+    return static_cast<char>(c);
+  }
+  if (c == WIDE_TAIL) {
+    return static_cast<char>(0x80);
+  }
+  return static_cast<char>(0x80 | std::max<char32_t>(c & 0x7F, 1));
+}
+
+void narrowCells(const char32_t * cells, size_t length, char * out) {
+  size_t i = 0;
+#ifdef __SSE2__
+  // scanByte, four cells at a time
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i high_bit = _mm_set1_epi32(0x80);
+  const __m128i low_bits = _mm_set1_epi32(0x7F);
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i tail = _mm_set1_epi32(WIDE_TAIL);
+  auto narrow = [&](const __m128i * from) {
+    __m128i c = _mm_loadu_si128(from);
+    __m128i ascii = _mm_cmplt_epi32(c, high_bit);
+    __m128i low = _mm_and_si128(c, low_bits);
+    low = _mm_or_si128(low, _mm_and_si128(_mm_cmpeq_epi32(low, zero), one));
+    low = _mm_andnot_si128(_mm_cmpeq_epi32(c, tail), low);
+    return _mm_or_si128(_mm_and_si128(ascii, c), _mm_andnot_si128(ascii, _mm_or_si128(low, high_bit)));
+  };
+  for (; i + 16 <= length; i += 16) {
+    const __m128i * from = reinterpret_cast<const __m128i *>(cells + i);
+    // every lane is a byte by now, so the saturating packs just pack
+    __m128i low = _mm_packs_epi32(narrow(from), narrow(from + 1));
+    __m128i high = _mm_packs_epi32(narrow(from + 2), narrow(from + 3));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(low, high));
+  }
+#endif
+  for (; i < length; ++i) {
+    out[i] = scanByte(cells[i]);
+  }
+}
+
+void appendUtf8(std::string & out, char32_t c) {
+  if (c < 0x80) {
+    out += static_cast<char>(c);
+  } else if (c < 0x800) {
+    out += static_cast<char>(0xC0 | c >> 6);
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else if (c < 0x10000) {
+    out += static_cast<char>(0xE0 | c >> 12);
+    out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | c >> 18);
+    out += static_cast<char>(0x80 | (c >> 12 & 0x3F));
+    out += static_cast<char>(0x80 | (c >> 6 & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  }
+}
+
+int displayWidth(char32_t c) {
+  if (c < 0x300) {
+    return 1;
+  }
+  if (lookup(ZERO_WIDTH, c, 1) == 0) {
+    return 0;
+  }
+  return lookup(WIDE, c, 1);
+}
+
+CharClass charClass(char32_t c) {
+  if (c < 128) {
+    return ASCII_CLASSES.of[c];
+  }
+  return lookup(CLASSES, c, CharClass::Word);
+}
@@ -0,0 +1,69 @@
+/*
+
+Copyright 2024 Tama McGlinn
+
+PacVim is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL) as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+PacVim program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef UNICODE_H
+#define UNICODE_H
+
+// Map text is UTF-8. Every line is decoded once, when the map is read,
+// into cells of one code point per screen column, so that everything
+// after that (reachability, the board, motions) counts columns and never
+// sees a byte sequence. A wide character (CJK, most emoji) takes two
+// columns: its own cell, and a WIDE_TAIL cell after it.
+//
+// Nearly all lines are plain ASCII; those are checked and widened 16
+// bytes at a time, without decoding, and narrowed back to bytes (for the
+// row scans) just as fast.
+
+#include <cstddef>
+#include <string>
+
+// the right half of a wide character; outside Unicode, so never a letter
+const char32_t WIDE_TAIL = 0x110000;
+const char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// what decodeCells had to change in a line
+const unsigned INVALID_UTF8 = 1; // bytes that aren't UTF-8 text, now U+FFFD
+const unsigned DROPPED_ZERO_WIDTH = 2; // combining accents and the like
+
+// decode a line into cells, as described above; returns the flags above,
+// 0 if every character came through as it was
+unsigned decodeCells(const std::string & line, std::u32string & cells);
+// A byte standing in for c, for scanning rows a byte at a time (see
+// rowScan.h): ASCII as it is, WIDE_TAIL as 0x80 and anything else as 0x80
+// plus its low 7 bits (at least 1). Outside ASCII a byte that matches is
+// only a candidate, to check against the letter itself.
+char scanByte(char32_t c);
+// the other way: scanByte of length cells, into out
+void narrowCells(const char32_t * cells, size_t length, char * out);
+// append c, encoded as UTF-8
+void appendUtf8(std::string & out, char32_t c);
+
+// the columns c takes on a terminal: 0, 1 or 2
+int displayWidth(char32_t c);
+
+// For w, e and b: a word is a run of characters of the same class, and
+// blanks are between words. In ASCII, letters and digits are words and
+// everything else is punctuation (as isalnum tells them apart); other
+// scripts get classes of their own, like vim gives them.
+enum class CharClass : unsigned char {
+  Blank, Punctuation, Word, Emoji, Braille, Hiragana, Katakana, Ideograph, Hangul
+};
+CharClass charClass(char32_t c);
+
+#endif